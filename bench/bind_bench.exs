@@ -0,0 +1,38 @@
+# Stmt bind path (NIF setters + bind_param + execute) against the stub libtaos,
+# compared with building the same insert through interpolation.
+Code.require_file("support/stub.exs", __DIR__)
+alias Tdex.Wrapper
+
+if Tdex.Bench.Stub.available?("bind") do
+  {:ok, conn} = Wrapper.taos_connect(~c"localhost", ~c"root", ~c"taosdata", ~c"taos", 6030)
+  sql = ~c"INSERT INTO t VALUES(?, ?, ?, ?)"
+  inputs =
+    for n <- [1, 100, 1000], into: %{} do
+      {"#{n} rows", Enum.map(1..n, fn i -> {1_700_000_000_000 + i, i * 0.5, i, "value-#{i}"} end)}
+    end
+
+  Benchee.run(
+    %{
+      "stmt bind" => fn rows ->
+        {:ok, stmt} = Wrapper.taos_stmt_init(conn, sql)
+        Enum.each(rows, fn {ts, v, i, s} ->
+          :ok = Wrapper.taos_multi_bind_set_timestamp(stmt, 0, ts)
+          :ok = Wrapper.taos_multi_bind_set_double(stmt, 1, v)
+          :ok = Wrapper.taos_multi_bind_set_int(stmt, 2, i)
+          :ok = Wrapper.taos_multi_bind_set_varchar(stmt, 3, s)
+          :ok = Wrapper.taos_stmt_bind_param_batch(stmt)
+        end)
+        {:ok, _} = Wrapper.taos_stmt_execute(stmt)
+        Wrapper.taos_stmt_close(stmt)
+      end,
+      "interpolate" => fn rows ->
+        Enum.each(rows, fn {ts, v, i, s} ->
+          {:ok, _} = Tdex.Common.interpolate_params("INSERT INTO t VALUES(?, ?, ?, ?)", [ts, v, i, s])
+        end)
+      end
+    },
+    inputs: inputs,
+    time: 3,
+    memory_time: 1
+  )
+end
@@ -0,0 +1,20 @@
+# Decode recorded (or synthetic) raw blocks with Tdex.Binary.parse_block/4.
+Code.require_file("support/block.exs", __DIR__)
+alias Tdex.Bench.Block
+
+inputs =
+  for name <- Block.names(), into: %{} do
+    %{field_names: names, precision: precision, blocks: blocks} = Block.load(name)
+    {Atom.to_string(name), {names, precision, Enum.map(blocks, &(<<0::128>> <> &1))}}
+  end
+
+Benchee.run(
+  %{
+    "parse_block" => fn {names, precision, blocks} ->
+      Enum.each(blocks, &Tdex.Binary.parse_block(&1, names, precision, []))
+    end
+  },
+  inputs: inputs,
+  time: 3,
+  memory_time: 1
+)
@@ -0,0 +1,21 @@
+# End-to-end through DBConnection and the native protocol against the stub
+# libtaos: checkout, query, raw block fetch and decode, without a server.
+Code.require_file("support/stub.exs", __DIR__)
+
+if Tdex.Bench.Stub.available?("driver") do
+  {:ok, pid} = Tdex.start_link(protocol: :native, database: "bench", pool_size: 4)
+  schema = %{ts: {:ts, 0}, v: {:double, 1}, i: {:int32, 2}, s: {:varchar, 3}}
+  insert = %Tdex.Query{schema: schema, statement: ~c"INSERT INTO t VALUES(?, ?, ?, ?)"}
+  rows = Enum.map(1..100, fn i -> %{ts: 1_700_000_000_000 + i, v: i * 0.5, i: i, s: "value-#{i}"} end)
+
+  Benchee.run(
+    %{
+      "select" => fn -> Tdex.query!(pid, "SELECT * FROM stub", []) end,
+      "select with params" => fn -> Tdex.query!(pid, "SELECT * FROM stub WHERE i > ? AND s = ?", [10, "a"]) end,
+      "insert 100 rows via schema" => fn -> {:ok, _, _} = Tdex.execute(pid, insert, rows) end
+    },
+    parallel: 4,
+    time: 3,
+    memory_time: 1
+  )
+end
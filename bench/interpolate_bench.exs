@@ -0,0 +1,14 @@
+# Client-side parameter interpolation used by the schema-less query path.
+inputs =
+  for n <- [2, 10, 50], into: %{} do
+    sql = "INSERT INTO t VALUES " <> Enum.map_join(1..n, ",", fn _ -> "(?)" end)
+    params = Enum.map(1..n, fn i -> if rem(i, 2) == 0, do: i * 1.5, else: "value-#{i}" end)
+    {"#{n} params", {sql, params}}
+  end
+
+Benchee.run(
+  %{"interpolate_params" => fn {sql, params} -> {:ok, _} = Tdex.Common.interpolate_params(sql, params) end},
+  inputs: inputs,
+  time: 3,
+  memory_time: 1
+)
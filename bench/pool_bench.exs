@@ -0,0 +1,23 @@
+# Stock DBConnection pool vs `pool_mode: :partitioned` under many concurrent
+# short queries against the stub libtaos. Compare the p99 column.
+Code.require_file("support/stub.exs", __DIR__)
+
+if Tdex.Bench.Stub.available?("pool") do
+  pool_size = System.schedulers_online() * 2
+  opts = [protocol: :native, database: "bench", pool_size: pool_size]
+  {:ok, stock} = Tdex.start_link(opts)
+  {:ok, partitioned} = Tdex.start_link([pool_mode: :partitioned] ++ opts)
+  sql = "INSERT INTO t VALUES (NOW, ?)"
+
+  Benchee.run(
+    %{
+      "stock pool" => fn -> Tdex.query!(stock, sql, [1]) end,
+      "partitioned pool" => fn -> Tdex.query!(partitioned, sql, [1]) end
+    },
+    parallel: System.schedulers_online() * 16,
+    time: 5,
+    warmup: 1,
+    formatters: [{Benchee.Formatters.Console, extended_statistics: true}],
+    percentiles: [50, 99]
+  )
+end
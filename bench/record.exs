@@ -0,0 +1,38 @@
+# Record raw block fixtures from a live server for decode_bench.exs:
+#
+#   TDEX_HOST=localhost TDEX_DB=bench mix run bench/record.exs
+#
+# Each query below must return at least one block; the first blocks are stored
+# in bench/fixtures/<name>.etf and replace the synthetic ones.
+Code.require_file("support/block.exs", __DIR__)
+alias Tdex.{Wrapper, Binary}
+
+queries = %{
+  wide_numeric: "SELECT * FROM wide_numeric LIMIT 4096",
+  nchar_heavy: "SELECT * FROM nchar_heavy LIMIT 4096",
+  json_tags: "SELECT * FROM json_tags LIMIT 4096",
+  many_nulls: "SELECT * FROM many_nulls LIMIT 4096"
+}
+
+host = System.get_env("TDEX_HOST", "localhost")
+db = System.get_env("TDEX_DB", "bench")
+{:ok, conn} = Wrapper.taos_connect(to_charlist(host), ~c"root", ~c"taosdata", to_charlist(db), 6030)
+
+read_blocks = fn read_blocks, res, acc ->
+  case Wrapper.taos_fetch_raw_block(res) do
+    {:ok, 0, _} -> Enum.reverse(acc)
+    {:ok, _rows, block} -> read_blocks.(read_blocks, res, [block | acc])
+  end
+end
+
+for {name, sql} <- queries do
+  {:ok, res} = Wrapper.taos_query(conn, to_charlist(sql))
+  {:ok, fields} = Wrapper.taos_fetch_fields(res)
+  {:ok, precision} = Wrapper.taos_result_precision(res)
+  blocks = read_blocks.(read_blocks, res, [])
+  Wrapper.taos_free_result(res)
+  field_names = Binary.parse_field(fields, [])
+  Tdex.Bench.Block.save(name, %{name: name, field_names: field_names, precision: precision, blocks: blocks})
+  IO.puts("#{name}: #{length(blocks)} blocks")
+end
+Wrapper.taos_close(conn)
@@ -0,0 +1,6 @@
+# Offline bench suite, see README "Benchmarks". `make bench` builds the NIF
+# against the stub libtaos and runs every script below.
+for name <- ~w(decode interpolate ws_frame bind driver pool) do
+  IO.puts("\n== #{name} ==")
+  Code.require_file("#{name}_bench.exs", __DIR__)
+end
@@ -0,0 +1,122 @@
+defmodule Tdex.Bench.Block do
+  @moduledoc """
+  Raw block fixtures for the bench suite.
+
+  `load/1` reads `bench/fixtures/<name>.etf` (written by `bench/record.exs` from a
+  live server) and falls back to a deterministic synthetic block with the same
+  layout `taos_fetch_raw_block` returns.
+  """
+  @rows 4096
+  @fixtures Path.expand("../fixtures", __DIR__)
+
+  def names(), do: [:wide_numeric, :nchar_heavy, :json_tags, :many_nulls]
+
+  def load(name) do
+    path = Path.join(@fixtures, "#{name}.etf")
+    if File.exists?(path) do
+      path |> File.read!() |> :erlang.binary_to_term()
+    else
+      generate(name)
+    end
+  end
+
+  def save(name, fixture) do
+    File.mkdir_p!(@fixtures)
+    File.write!(Path.join(@fixtures, "#{name}.etf"), :erlang.term_to_binary(fixture))
+  end
+
+  def generate(name) do
+    :rand.seed(:exsss, {1, 2, 3})
+    columns = [{"ts", 9, 8, Enum.map(1..@rows, &(1_700_000_000_000 + &1))} | columns(name)]
+    %{
+      name: name,
+      field_names: Enum.map(columns, &elem(&1, 0)),
+      precision: 0,
+      blocks: [encode(columns)]
+    }
+  end
+
+  defp columns(:wide_numeric) do
+    for {type, bytes, n} <- [{4, 4, 8}, {5, 8, 8}, {7, 8, 8}, {6, 4, 4}], i <- 1..n do
+      {"c#{type}_#{i}", type, bytes, Enum.map(1..@rows, fn _ -> number(type) end)}
+    end
+  end
+  defp columns(:nchar_heavy) do
+    for i <- 1..4 do
+      {"n#{i}", 10, 64 * 4 + 2, Enum.map(1..@rows, fn r -> "ẽric-#{r}-" <> String.duplicate("ữ", rem(r, 24)) end)}
+    end
+  end
+  defp columns(:json_tags) do
+    [
+      {"v", 7, 8, Enum.map(1..@rows, fn _ -> :rand.uniform() end)},
+      {"location", 8, 66, Enum.map(1..@rows, fn r -> "site-#{rem(r, 32)}" end)},
+      {"tags", 15, 4096, Enum.map(1..@rows, fn r ->
+        Jason.encode!(%{site: "site-#{rem(r, 32)}", rack: rem(r, 8), labels: ["a", "b"]})
+      end)}
+    ]
+  end
+  defp columns(:many_nulls) do
+    for {type, bytes} <- [{4, 4}, {7, 8}, {8, 66}, {10, 258}, {1, 1}, {5, 8}] do
+      {"c#{type}", type, bytes, Enum.map(1..@rows, fn r ->
+        if :rand.uniform() < 0.7, do: nil, else: value(type, r)
+      end)}
+    end
+  end
+
+  defp number(4), do: :rand.uniform(1_000_000) - 500_000
+  defp number(5), do: :rand.uniform(1_000_000_000_000) - 500_000_000_000
+  defp number(6), do: :rand.uniform() * 1000
+  defp number(7), do: :rand.uniform() * 1_000_000
+
+  defp value(1, r), do: rem(r, 2) == 0
+  defp value(8, r), do: "value-#{r}"
+  defp value(10, r), do: "ẽ-#{r}"
+  defp value(type, _r), do: number(type)
+
+  def encode(columns) do
+    rows = columns |> hd() |> elem(3) |> length()
+    meta = for {_, type, bytes, _} <- columns, into: <<>>, do: <<type::8, bytes::32-little>>
+    datas = Enum.map(columns, fn {_, type, bytes, values} -> encode_column(type, bytes, values) end)
+    lengths = for {_, data} <- datas, into: <<>>, do: <<byte_size(data)::32-little>>
+    body = for {prefix, data} <- datas, into: <<>>, do: <<prefix::binary, data::binary>>
+    size = 28 + byte_size(meta) + byte_size(lengths) + byte_size(body)
+    <<1::32-little, size::32-little, rows::32-little, length(columns)::32-little, 0::32, 0::64,
+      meta::binary, lengths::binary, body::binary>>
+  end
+
+  defp encode_column(type, _bytes, values) when type in [8, 10, 15, 16] do
+    {offsets, data, _} =
+      Enum.reduce(values, {[], [], 0}, fn
+        nil, {o, d, off} -> {[<<-1::32-little-signed>> | o], d, off}
+        v, {o, d, off} ->
+          bin = encode_var(type, v)
+          entry = <<byte_size(bin)::16-little, bin::binary>>
+          {[<<off::32-little>> | o], [entry | d], off + byte_size(entry)}
+      end)
+    {IO.iodata_to_binary(Enum.reverse(offsets)), IO.iodata_to_binary(Enum.reverse(data))}
+  end
+  defp encode_column(type, _bytes, values) do
+    bits = Enum.map(values, fn v -> if is_nil(v), do: 1, else: 0 end)
+    pad = rem(8 - rem(length(bits), 8), 8)
+    bitmap = for b <- bits ++ List.duplicate(0, pad), into: <<>>, do: <<b::1>>
+    data = for v <- values, into: <<>>, do: encode_fixed(type, v)
+    {bitmap, data}
+  end
+
+  defp encode_var(10, v), do: :unicode.characters_to_binary(v, :utf8, {:utf32, :little})
+  defp encode_var(_type, v), do: v
+
+  defp encode_fixed(type, nil), do: encode_fixed(type, if(type in [6, 7], do: 0.0, else: 0))
+  defp encode_fixed(1, v), do: <<if(v in [true, 1], do: 1, else: 0)::8>>
+  defp encode_fixed(2, v), do: <<v::8-little-signed>>
+  defp encode_fixed(3, v), do: <<v::16-little-signed>>
+  defp encode_fixed(4, v), do: <<v::32-little-signed>>
+  defp encode_fixed(5, v), do: <<v::64-little-signed>>
+  defp encode_fixed(6, v), do: <<v::32-float-little>>
+  defp encode_fixed(7, v), do: <<v::64-float-little>>
+  defp encode_fixed(9, v), do: <<v::64-little-signed>>
+  defp encode_fixed(11, v), do: <<v::8-little-unsigned>>
+  defp encode_fixed(12, v), do: <<v::16-little-unsigned>>
+  defp encode_fixed(13, v), do: <<v::32-little-unsigned>>
+  defp encode_fixed(14, v), do: <<v::64-little-unsigned>>
+end
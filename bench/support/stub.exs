@@ -0,0 +1,11 @@
+defmodule Tdex.Bench.Stub do
+  @moduledoc false
+
+  # Benches that go through the NIF need it built against c_src/stub (`make stub`).
+  # Scripts wrap their body in `if available?(name)` so bench/run.exs goes on with the next one.
+  def available?(name) do
+    stub? = System.get_env("TDEX_STUB") == "1"
+    unless stub?, do: IO.puts("skipping #{name} bench: run with `make bench` (NIF linked against the stub libtaos)")
+    stub?
+  end
+end
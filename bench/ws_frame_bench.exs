@@ -0,0 +1,32 @@
+# WebSocket frame handling without a socket: frames are delivered to the bench
+# process the way gun does and read back through Tdex.WS.Connection.recv_ws/1.
+Code.require_file("support/block.exs", __DIR__)
+alias Tdex.Bench.Block
+alias Tdex.WS.Connection
+
+%{field_names: names, precision: precision, blocks: [block | _]} = Block.load(:wide_numeric)
+binary_frame = <<0::128>> <> block
+text_frame = Jason.encode!(%{
+  code: 0, message: "", action: "query", req_id: 1, id: 1, is_update: false, affected_rows: 0,
+  fields_count: length(names), fields_names: names, fields_types: List.duplicate(4, length(names)),
+  fields_lengths: List.duplicate(4, length(names)), precision: precision
+})
+
+Benchee.run(
+  %{
+    "recv text" => fn ->
+      send(self(), {:gun_ws, self(), nil, {:text, text_frame}})
+      {:ok, _} = Connection.recv_ws(0)
+    end,
+    "recv binary + decode" => fn ->
+      send(self(), {:gun_ws, self(), nil, {:binary, binary_frame}})
+      {:ok, data} = Connection.recv_ws(0)
+      Tdex.Binary.parse_block(data, names, precision, [])
+    end,
+    "encode action" => fn ->
+      Jason.encode!(%{action: "fetch_block", args: %{req_id: 1, id: 1}})
+    end
+  },
+  time: 3,
+  memory_time: 1
+)
@@ -2,13 +2,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
 #include <taos.h>
 
 static ErlNifResourceType* TAOS_TYPE;
 static ErlNifResourceType* TAOS_RES_TYPE;
-static ErlNifResourceType* TAOS_ROW_TYPE;
-static ErlNifResourceType* TAOS_FIELD_TYPE;
 static ErlNifResourceType* TAOS_STMT_TYPE;
+static ErlNifResourceType* TMQ_TYPE;
 
 static ERL_NIF_TERM atom_ok;
 static ERL_NIF_TERM atom_error_connect;
@@ -17,6 +20,21 @@ static ERL_NIF_TERM atom_invalid_resource;
 static ERL_NIF_TERM atom_excute_statement_fail;
 static ERL_NIF_TERM atom_less_memory;
 static ERL_NIF_TERM atom_error_timeout;
+static ERL_NIF_TERM atom_nil;
+static ERL_NIF_TERM atom_true;
+static ERL_NIF_TERM atom_false;
+static ERL_NIF_TERM atom_bad_row;
+static ERL_NIF_TERM atom_bad_value;
+static ERL_NIF_TERM atom_struct;
+static ERL_NIF_TERM atom_tmq_message;
+static ERL_NIF_TERM atom_tdex_tmq;
+static ERL_NIF_TERM atom_consumer;
+static ERL_NIF_TERM atom_topic;
+static ERL_NIF_TERM atom_database;
+static ERL_NIF_TERM atom_vgroup_id;
+static ERL_NIF_TERM atom_offset;
+static ERL_NIF_TERM atom_precision;
+static ERL_NIF_TERM atom_blocks;
 
 static int32_t boolLen;
 static int32_t sintLen;
@@ -26,35 +44,82 @@ static int32_t floatLen;
 static int32_t doubleLen;
 static char is_null;
 
+static struct {
+  uint64_t blocks;
+  uint64_t bytes;
+  int64_t live_conn;
+  int64_t live_res;
+  int64_t live_stmt;
+  int64_t live_tmq;
+  uint64_t bind_allocs;
+  int64_t live_binds;
+  uint64_t gc_conn;
+  uint64_t gc_res;
+  uint64_t gc_stmt;
+} stats;
+
+#define STAT_ADD(field, n) __atomic_add_fetch(&stats.field, (n), __ATOMIC_RELAXED)
+#define STAT_GET(field) __atomic_load_n(&stats.field, __ATOMIC_RELAXED)
+
+/* A handle is NULL once it has been freed, either explicitly or by the
+ * resource destructor, so every free path is idempotent. Results and
+ * statements keep their connection resource alive until they are freed, and
+ * count as `children` of the TAOS handle while their own handle is live: an
+ * explicit close only marks the connection `closing` and the last child to go
+ * closes the handle. */
 typedef struct {
   TAOS* taos;
+  int children;
+  int closing;
 } taos_t;
 
-typedef struct {
-  TAOS_RES* taos_res;
-} taos_res_t;
+typedef struct taos_stmt_s taos_stmt_t;
 
 typedef struct {
+  TAOS_RES* taos_res;
   TAOS_ROW taos_row;
-} taos_row_t;
-
-typedef struct {
-  TAOS_FIELD* taos_field;
-} taos_field_t;
+  taos_t* conn;
+  taos_stmt_t* stmt;
+  int stoppers;
+} taos_res_t;
 
-typedef struct {
+/* Results from taos_stmt_use_result borrow the statement's handle and are
+ * counted in `results`; an explicit close while one is live only marks the
+ * statement `closing` and the last result freed closes it. */
+struct taos_stmt_s {
   TAOS_STMT* stmt;
   TAOS_MULTI_BIND* params;
   int param_count;
-} taos_stmt_t;
+  taos_t* conn;
+  int results;
+  int closing;
+};
+
+/* The poll thread is detached and holds a reference on the resource until it
+ * exits, so the destructor never waits for it. `running` asks it to poll,
+ * `alive` is cleared as it leaves tmq_consumer_poll for good. */
+typedef struct {
+  tmq_t* tmq;
+  ErlNifMutex* lock;
+  ErlNifCond* cond;
+  ErlNifPid owner;
+  ErlNifPid subscriber;
+  ErlNifMonitor monitor;
+  int64_t timeout;
+  int demand;
+  int running;
+  int alive;
+} taos_tmq_t;
 
 static void free_parm(TAOS_MULTI_BIND* params, int count);
 static ERL_NIF_TERM make_string(ErlNifEnv* env, char* str);
+static ERL_NIF_TERM make_raw_block(ErlNifEnv* env, void* pg_data);
 
 static void free_parm(TAOS_MULTI_BIND* params, int count){
   for(int i = 0; i < count; i++){
     TAOS_MULTI_BIND* prm = params + i;
     if(prm->buffer){
+      STAT_ADD(live_binds, -1);
       free(prm->buffer);
       free(prm->length);
       prm->buffer = NULL;
@@ -74,13 +139,118 @@ static ERL_NIF_TERM make_string(ErlNifEnv* env, char* str) {
   return term;
 }
 
+static ERL_NIF_TERM make_raw_block(ErlNifEnv* env, void* pg_data) {
+  ErlNifBinary bin;
+  int size = 0;
+  memcpy(&size, (char*)pg_data + 4, 4);
+  STAT_ADD(blocks, 1);
+  STAT_ADD(bytes, size);
+  enif_alloc_binary(size, &bin);
+  memcpy(bin.data, pg_data, size);
+  ERL_NIF_TERM term = enif_make_binary(env, &bin);
+  enif_release_binary(&bin);
+  return term;
+}
+
+static int get_taos(ErlNifEnv* env, ERL_NIF_TERM term, taos_t** taos_ptr) {
+  return enif_get_resource(env, term, TAOS_TYPE, (void**) taos_ptr) && (*taos_ptr)->taos != NULL
+    && !__atomic_load_n(&(*taos_ptr)->closing, __ATOMIC_SEQ_CST);
+}
+
+static int get_res(ErlNifEnv* env, ERL_NIF_TERM term, taos_res_t** res_ptr) {
+  return enif_get_resource(env, term, TAOS_RES_TYPE, (void**) res_ptr) && (*res_ptr)->taos_res != NULL;
+}
+
+static int get_stmt(ErlNifEnv* env, ERL_NIF_TERM term, taos_stmt_t** stmt_ptr) {
+  return enif_get_resource(env, term, TAOS_STMT_TYPE, (void**) stmt_ptr) && (*stmt_ptr)->stmt != NULL
+    && !__atomic_load_n(&(*stmt_ptr)->closing, __ATOMIC_SEQ_CST);
+}
+
+static void shut_taos(taos_t* taos_ptr) {
+  TAOS* taos = __atomic_exchange_n(&taos_ptr->taos, NULL, __ATOMIC_ACQ_REL);
+  if(taos == NULL) return;
+  taos_close(taos);
+  STAT_ADD(live_conn, -1);
+}
+
+static void close_taos(taos_t* taos_ptr) {
+  __atomic_store_n(&taos_ptr->closing, 1, __ATOMIC_SEQ_CST);
+  if(__atomic_load_n(&taos_ptr->children, __ATOMIC_SEQ_CST) == 0) shut_taos(taos_ptr);
+}
+
+static void conn_retain(taos_t* taos_ptr) {
+  __atomic_add_fetch(&taos_ptr->children, 1, __ATOMIC_SEQ_CST);
+}
+
+static void conn_release(taos_t* taos_ptr) {
+  if(__atomic_sub_fetch(&taos_ptr->children, 1, __ATOMIC_SEQ_CST) == 0
+    && __atomic_load_n(&taos_ptr->closing, __ATOMIC_SEQ_CST)) shut_taos(taos_ptr);
+}
+
+/* Takes a child reference for a native call that uses the handle, before the
+ * handle is read, so a concurrent close waits for the call. NULL when the
+ * connection is already closing; the caller owns one conn_release otherwise. */
+static TAOS* conn_acquire(taos_t* taos_ptr) {
+  conn_retain(taos_ptr);
+  TAOS* taos = __atomic_load_n(&taos_ptr->taos, __ATOMIC_SEQ_CST);
+  if(taos == NULL || __atomic_load_n(&taos_ptr->closing, __ATOMIC_SEQ_CST)){
+    conn_release(taos_ptr);
+    return NULL;
+  }
+  return taos;
+}
+
+/* taos_stop_query may come from a deadline watchdog while the owner frees the
+ * result; the free waits for a stop that already saw the handle. */
+static void stop_res(taos_res_t* res_ptr) {
+  __atomic_add_fetch(&res_ptr->stoppers, 1, __ATOMIC_SEQ_CST);
+  TAOS_RES* res = __atomic_load_n(&res_ptr->taos_res, __ATOMIC_SEQ_CST);
+  if(res != NULL) taos_stop_query(res);
+  __atomic_sub_fetch(&res_ptr->stoppers, 1, __ATOMIC_SEQ_CST);
+}
+
+static int close_stmt(taos_stmt_t* stmt_ptr);
+
+static void stmt_release(taos_stmt_t* stmt_ptr) {
+  if(__atomic_sub_fetch(&stmt_ptr->results, 1, __ATOMIC_SEQ_CST) == 0
+    && __atomic_load_n(&stmt_ptr->closing, __ATOMIC_SEQ_CST)) close_stmt(stmt_ptr);
+}
+
+static int free_res(taos_res_t* res_ptr) {
+  TAOS_RES* res = __atomic_exchange_n(&res_ptr->taos_res, NULL, __ATOMIC_SEQ_CST);
+  if(res == NULL) return 0;
+  while(__atomic_load_n(&res_ptr->stoppers, __ATOMIC_SEQ_CST) > 0) sched_yield();
+  if(res_ptr->stmt == NULL){
+    taos_free_result(res);
+    conn_release(res_ptr->conn);
+  } else {
+    stmt_release(res_ptr->stmt);
+  }
+  STAT_ADD(live_res, -1);
+  return 1;
+}
+
+static int close_stmt(taos_stmt_t* stmt_ptr) {
+  TAOS_STMT* stmt = __atomic_exchange_n(&stmt_ptr->stmt, NULL, __ATOMIC_ACQ_REL);
+  if(stmt == NULL) return 0;
+  taos_stmt_close(stmt);
+  conn_release(stmt_ptr->conn);
+  STAT_ADD(live_stmt, -1);
+  if(stmt_ptr->params){
+    free_parm(stmt_ptr->params, stmt_ptr->param_count);
+    free(stmt_ptr->params);
+    stmt_ptr->params = NULL;
+  }
+  return 1;
+}
+
 static ERL_NIF_TERM taos_stmt_init_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
   if (argc != 2) {
     return enif_make_badarg(env);
   }
 
   taos_t* taos_ptr = NULL;
-  if(!enif_get_resource(env, argv[0], TAOS_TYPE, (void**) &taos_ptr)){
+  if(!get_taos(env, argv[0], &taos_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
 
@@ -95,24 +265,39 @@ static ERL_NIF_TERM taos_stmt_init_nif(ErlNifEnv* env, int argc, const ERL_NIF_T
     if(sql[i] == '?') param_count++;
   }
   
-  TAOS_STMT *stmt = taos_stmt_init(taos_ptr->taos);
+  TAOS* taos = conn_acquire(taos_ptr);
+  if(taos == NULL){
+    return enif_make_tuple2(env, atom_error, atom_invalid_resource);
+  }
+  TAOS_STMT *stmt = taos_stmt_init(taos);
+  if(stmt == NULL){
+    conn_release(taos_ptr);
+    return enif_make_tuple2(env, atom_error, atom_less_memory);
+  }
   int code = taos_stmt_prepare(stmt, sql, 0);
   if(code){
     taos_stmt_close(stmt);
+    conn_release(taos_ptr);
     return enif_make_tuple2(env, atom_error, enif_make_int(env, code));
   }
   TAOS_MULTI_BIND* params = NULL;
   if(param_count > 0){
-    params = (TAOS_MULTI_BIND*)malloc(sizeof(TAOS_MULTI_BIND) * param_count);
+    params = (TAOS_MULTI_BIND*)calloc(param_count, sizeof(TAOS_MULTI_BIND));
     if(params == NULL){
       taos_stmt_close(stmt);
+      conn_release(taos_ptr);
       return enif_make_tuple2(env, atom_error, atom_less_memory);
     }
   } 
+  STAT_ADD(live_stmt, 1);
   taos_stmt_t* stmt_ptr = (taos_stmt_t*)enif_alloc_resource(TAOS_STMT_TYPE, sizeof(taos_stmt_t));
   stmt_ptr->stmt = stmt;
   stmt_ptr->params = params;
   stmt_ptr->param_count = param_count;
+  stmt_ptr->conn = taos_ptr;
+  stmt_ptr->results = 0;
+  stmt_ptr->closing = 0;
+  enif_keep_resource(taos_ptr);
   ERL_NIF_TERM result = enif_make_resource(env, stmt_ptr);
   enif_release_resource(stmt_ptr);
   return enif_make_tuple2(env, atom_ok, result);
@@ -123,7 +308,7 @@ static ERL_NIF_TERM taos_stmt_bind_param_batch_nif(ErlNifEnv* env, int argc, con
     return enif_make_badarg(env);
   }
   taos_stmt_t* stmt_ptr = NULL;
-  if(!enif_get_resource(env, argv[0], TAOS_STMT_TYPE, (void**) &stmt_ptr)){
+  if(!get_stmt(env, argv[0], &stmt_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
   if(stmt_ptr->params) taos_stmt_bind_param(stmt_ptr->stmt, stmt_ptr->params);
@@ -132,12 +317,376 @@ static ERL_NIF_TERM taos_stmt_bind_param_batch_nif(ErlNifEnv* env, int argc, con
   return atom_ok;
 }
 
+/* Columnar bulk bind. Every row is either a CSV line (binary) or a list of
+ * terms; `types` holds the TSDB type of each column. The rows become one
+ * TAOS_MULTI_BIND per column (num = rows) and one batch, and the buffers are
+ * released once the batch is added, so memory is bounded by one batch. */
+#define BULK_NULL 0
+#define BULK_STR 1
+#define BULK_TERM 2
+
+typedef struct {
+  int kind;
+  const char* str;
+  int len;
+  ERL_NIF_TERM term;
+} bulk_cell_t;
+
+static int bulk_type_size(int type) {
+  switch(type){
+    case TSDB_DATA_TYPE_BOOL:
+    case TSDB_DATA_TYPE_TINYINT: return 1;
+    case TSDB_DATA_TYPE_SMALLINT: return 2;
+    case TSDB_DATA_TYPE_INT:
+    case TSDB_DATA_TYPE_FLOAT: return 4;
+    case TSDB_DATA_TYPE_BIGINT:
+    case TSDB_DATA_TYPE_TIMESTAMP:
+    case TSDB_DATA_TYPE_DOUBLE: return 8;
+    default: return 0;
+  }
+}
+
+/* Quoted fields may contain commas, doubled quotes inside them are unescaped
+ * into `scratch`. An empty unquoted field or NULL is a null cell. */
+static int bulk_split_csv(const char* line, int len, bulk_cell_t* cells, int cols, char** scratch) {
+  int pos = 0;
+  if(len > 0 && line[len - 1] == '\r') len--;
+  for(int c = 0; c < cols; c++){
+    bulk_cell_t* cell = cells + c;
+    if(pos > len) return 0;
+    if(pos < len && line[pos] == '"'){
+      int start = ++pos, n = 0, escaped = 0;
+      char* out = *scratch;
+      while(pos < len){
+        if(line[pos] == '"'){
+          if(pos + 1 < len && line[pos + 1] == '"'){
+            escaped = 1;
+            out[n++] = '"';
+            pos += 2;
+            continue;
+          }
+          break;
+        }
+        out[n++] = line[pos++];
+      }
+      if(pos >= len) return 0;
+      pos++;
+      if(pos < len && line[pos] != ',') return 0;
+      pos++;
+      cell->kind = BULK_STR;
+      cell->str = escaped ? out : line + start;
+      cell->len = n;
+      if(escaped) *scratch += n;
+    } else {
+      int start = pos;
+      while(pos < len && line[pos] != ',') pos++;
+      cell->str = line + start;
+      cell->len = pos - start;
+      cell->kind = (cell->len == 0 || (cell->len == 4 && strncasecmp(cell->str, "null", 4) == 0)) ? BULK_NULL : BULK_STR;
+      pos++;
+    }
+  }
+  return pos > len;
+}
+
+static int bulk_get_int64(ErlNifEnv* env, bulk_cell_t* cell, int64_t* v) {
+  if(cell->kind == BULK_TERM) return enif_get_int64(env, cell->term, (ErlNifSInt64*)v);
+  char buf[32];
+  char* end;
+  if(cell->len >= (int)sizeof(buf)) return 0;
+  memcpy(buf, cell->str, cell->len);
+  buf[cell->len] = 0;
+  errno = 0;
+  *v = strtoll(buf, &end, 10);
+  return end != buf && *end == 0 && errno == 0;
+}
+
+/* Out of range values are rejected rather than truncated. */
+static int bulk_get_int_range(ErlNifEnv* env, bulk_cell_t* cell, int64_t min, int64_t max, int64_t* v) {
+  return bulk_get_int64(env, cell, v) && *v >= min && *v <= max;
+}
+
+static int bulk_get_double(ErlNifEnv* env, bulk_cell_t* cell, double* v) {
+  if(cell->kind == BULK_TERM){
+    ErlNifSInt64 i;
+    if(enif_get_double(env, cell->term, v)) return 1;
+    if(!enif_get_int64(env, cell->term, &i)) return 0;
+    *v = (double)i;
+    return 1;
+  }
+  char buf[64];
+  char* end;
+  if(cell->len >= (int)sizeof(buf)) return 0;
+  memcpy(buf, cell->str, cell->len);
+  buf[cell->len] = 0;
+  *v = strtod(buf, &end);
+  return end != buf && *end == 0;
+}
+
+static int bulk_get_bool(ErlNifEnv* env, bulk_cell_t* cell, int8_t* v) {
+  int64_t i;
+  if(cell->kind == BULK_TERM){
+    if(enif_is_identical(cell->term, atom_true)) *v = 1;
+    else if(enif_is_identical(cell->term, atom_false)) *v = 0;
+    else if(enif_get_int64(env, cell->term, (ErlNifSInt64*)&i)) *v = i != 0;
+    else return 0;
+    return 1;
+  }
+  if(cell->len == 4 && strncasecmp(cell->str, "true", 4) == 0) *v = 1;
+  else if(cell->len == 5 && strncasecmp(cell->str, "false", 5) == 0) *v = 0;
+  else if(bulk_get_int64(env, cell, &i)) *v = i != 0;
+  else return 0;
+  return 1;
+}
+
+static int bulk_get_bytes(ErlNifEnv* env, bulk_cell_t* cell, const char** p, int* len) {
+  if(cell->kind == BULK_TERM){
+    ErlNifBinary bin;
+    if(!enif_inspect_binary(env, cell->term, &bin)) return 0;
+    *p = (const char*)bin.data;
+    *len = bin.size;
+    return 1;
+  }
+  *p = cell->str;
+  *len = cell->len;
+  return 1;
+}
+
+static int bulk_set_value(ErlNifEnv* env, int type, bulk_cell_t* cell, char* buf, int32_t* len) {
+  int64_t i;
+  double d;
+  const char* p;
+  int n;
+  switch(type){
+    case TSDB_DATA_TYPE_BOOL:
+      return bulk_get_bool(env, cell, (int8_t*)buf);
+    case TSDB_DATA_TYPE_TINYINT:
+      if(!bulk_get_int_range(env, cell, INT8_MIN, INT8_MAX, &i)) return 0;
+      *(int8_t*)buf = (int8_t)i;
+      return 1;
+    case TSDB_DATA_TYPE_SMALLINT:
+      if(!bulk_get_int_range(env, cell, INT16_MIN, INT16_MAX, &i)) return 0;
+      *(int16_t*)buf = (int16_t)i;
+      return 1;
+    case TSDB_DATA_TYPE_INT:
+      if(!bulk_get_int_range(env, cell, INT32_MIN, INT32_MAX, &i)) return 0;
+      *(int32_t*)buf = (int32_t)i;
+      return 1;
+    case TSDB_DATA_TYPE_BIGINT:
+    case TSDB_DATA_TYPE_TIMESTAMP:
+      return bulk_get_int64(env, cell, (int64_t*)buf);
+    case TSDB_DATA_TYPE_FLOAT:
+      if(!bulk_get_double(env, cell, &d)) return 0;
+      *(float*)buf = (float)d;
+      return 1;
+    case TSDB_DATA_TYPE_DOUBLE:
+      return bulk_get_double(env, cell, (double*)buf);
+    default:
+      if(!bulk_get_bytes(env, cell, &p, &n)) return 0;
+      memcpy(buf, p, n);
+      *len = n;
+      return 1;
+  }
+}
+
+static void bulk_free_binds(TAOS_MULTI_BIND* binds, int cols) {
+  if(binds == NULL) return;
+  for(int c = 0; c < cols; c++){
+    free(binds[c].buffer);
+    free(binds[c].length);
+    free(binds[c].is_null);
+  }
+  free(binds);
+}
+
+/* `batch` binds through taos_stmt_bind_param_batch for bulk inserts; otherwise
+ * the single row is bound with taos_stmt_bind_param and only insert
+ * statements add a batch, so the same path serves prepared queries. */
+static ERL_NIF_TERM bind_rows(ErlNifEnv* env, taos_stmt_t* stmt_ptr, ERL_NIF_TERM types_term, ERL_NIF_TERM rows_term, int batch) {
+  unsigned cols, rows;
+  if(!enif_get_list_length(env, types_term, &cols) || cols == 0 || !enif_get_list_length(env, rows_term, &rows)){
+    return enif_make_badarg(env);
+  };
+  if(rows == 0) return enif_make_tuple2(env, atom_ok, enif_make_int(env, 0));
+
+  int types[cols];
+  ERL_NIF_TERM head, tail = types_term;
+  for(unsigned c = 0; enif_get_list_cell(env, tail, &head, &tail); c++){
+    if(!enif_get_int(env, head, types + c)) return enif_make_badarg(env);
+  }
+
+  size_t scratch_size = 1;
+  ErlNifBinary line;
+  tail = rows_term;
+  while(enif_get_list_cell(env, tail, &head, &tail)){
+    if(enif_inspect_binary(env, head, &line)) scratch_size += line.size;
+  }
+  ERL_NIF_TERM result = atom_ok;
+  bulk_cell_t* cells = (bulk_cell_t*)calloc((size_t)rows * cols, sizeof(bulk_cell_t));
+  char* scratch_base = (char*)malloc(scratch_size);
+  TAOS_MULTI_BIND* binds = (TAOS_MULTI_BIND*)calloc(cols, sizeof(TAOS_MULTI_BIND));
+  char* scratch = scratch_base;
+  if(cells == NULL || scratch_base == NULL || binds == NULL){
+    result = atom_less_memory;
+    goto done;
+  }
+
+  tail = rows_term;
+  for(unsigned r = 0; enif_get_list_cell(env, tail, &head, &tail); r++){
+    bulk_cell_t* row = cells + (size_t)r * cols;
+    unsigned row_len;
+    if(enif_inspect_binary(env, head, &line)){
+      if(!bulk_split_csv((const char*)line.data, line.size, row, cols, &scratch)){
+        result = enif_make_tuple2(env, atom_bad_row, enif_make_uint(env, r));
+        goto done;
+      }
+    } else if(enif_get_list_length(env, head, &row_len) && row_len == cols){
+      ERL_NIF_TERM v, vs = head;
+      for(unsigned c = 0; enif_get_list_cell(env, vs, &v, &vs); c++){
+        row[c].kind = enif_is_identical(v, atom_nil) ? BULK_NULL : BULK_TERM;
+        row[c].term = v;
+      }
+    } else {
+      result = enif_make_tuple2(env, atom_bad_row, enif_make_uint(env, r));
+      goto done;
+    }
+  }
+
+  for(unsigned c = 0; c < cols; c++){
+    TAOS_MULTI_BIND* bind = binds + c;
+    int size = bulk_type_size(types[c]);
+    if(size == 0){
+      const char* p;
+      int n;
+      size = 1;
+      for(unsigned r = 0; r < rows; r++){
+        bulk_cell_t* cell = cells + (size_t)r * cols + c;
+        if(cell->kind != BULK_NULL && bulk_get_bytes(env, cell, &p, &n) && n > size) size = n;
+      }
+    }
+    bind->buffer_type = types[c];
+    bind->buffer_length = size;
+    bind->num = rows;
+    bind->buffer = calloc(rows, size);
+    bind->length = (int32_t*)malloc(rows * sizeof(int32_t));
+    bind->is_null = (char*)malloc(rows);
+    if(bind->buffer == NULL || bind->length == NULL || bind->is_null == NULL){
+      result = atom_less_memory;
+      goto done;
+    }
+    for(unsigned r = 0; r < rows; r++){
+      bulk_cell_t* cell = cells + (size_t)r * cols + c;
+      bind->length[r] = size;
+      bind->is_null[r] = cell->kind == BULK_NULL;
+      if(cell->kind == BULK_NULL) continue;
+      if(!bulk_set_value(env, types[c], cell, (char*)bind->buffer + (size_t)r * size, bind->length + r)){
+        result = enif_make_tuple3(env, atom_bad_value, enif_make_uint(env, r), enif_make_uint(env, c));
+        goto done;
+      }
+    }
+  }
+
+  int code;
+  if(batch){
+    code = taos_stmt_bind_param_batch(stmt_ptr->stmt, binds);
+    if(code == 0) code = taos_stmt_add_batch(stmt_ptr->stmt);
+  } else {
+    int insert = 0;
+    code = taos_stmt_bind_param(stmt_ptr->stmt, binds);
+    if(code == 0) code = taos_stmt_is_insert(stmt_ptr->stmt, &insert);
+    if(code == 0 && insert) code = taos_stmt_add_batch(stmt_ptr->stmt);
+  }
+  if(code != 0){
+    result = enif_make_tuple2(env, enif_make_int(env, code), make_string(env, taos_stmt_errstr(stmt_ptr->stmt)));
+  }
+
+done:
+  /* every failure, out of memory included, is {:error, reason} */
+  bulk_free_binds(binds, cols);
+  free(scratch_base);
+  free(cells);
+  if(result != atom_ok) return enif_make_tuple2(env, atom_error, result);
+  return enif_make_tuple2(env, atom_ok, enif_make_uint(env, rows));
+}
+
+static ERL_NIF_TERM taos_stmt_bind_rows_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 3) {
+    return enif_make_badarg(env);
+  }
+  taos_stmt_t* stmt_ptr = NULL;
+  if(!get_stmt(env, argv[0], &stmt_ptr)){
+    return enif_make_tuple2(env, atom_error, atom_invalid_resource);
+  };
+  return bind_rows(env, stmt_ptr, argv[1], argv[2], 1);
+}
+
+static ERL_NIF_TERM taos_stmt_bind_row_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 3) {
+    return enif_make_badarg(env);
+  }
+  taos_stmt_t* stmt_ptr = NULL;
+  if(!get_stmt(env, argv[0], &stmt_ptr)){
+    return enif_make_tuple2(env, atom_error, atom_invalid_resource);
+  };
+  return bind_rows(env, stmt_ptr, argv[1], enif_make_list1(env, argv[2]), 0);
+}
+
+/* Column types an insert statement expects for its parameters, nil for queries. */
+static ERL_NIF_TERM taos_stmt_param_types_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 1) {
+    return enif_make_badarg(env);
+  }
+  taos_stmt_t* stmt_ptr = NULL;
+  if(!get_stmt(env, argv[0], &stmt_ptr)){
+    return enif_make_tuple2(env, atom_error, atom_invalid_resource);
+  };
+  int insert = 0, nums = 0;
+  int code = taos_stmt_is_insert(stmt_ptr->stmt, &insert);
+  if(code == 0 && !insert) return enif_make_tuple2(env, atom_ok, atom_nil);
+  if(code == 0) code = taos_stmt_num_params(stmt_ptr->stmt, &nums);
+  ERL_NIF_TERM types = enif_make_list(env, 0);
+  for(int i = nums - 1; code == 0 && i >= 0; i--){
+    int type = 0, bytes = 0;
+    code = taos_stmt_get_param(stmt_ptr->stmt, i, &type, &bytes);
+    types = enif_make_list_cell(env, enif_make_int(env, type), types);
+  }
+  if(code != 0) return enif_make_tuple2(env, atom_error, enif_make_int(env, code));
+  return enif_make_tuple2(env, atom_ok, types);
+}
+
+/* The result of an executed query statement belongs to the statement: it is
+ * never passed to taos_free_result and keeps the statement alive. */
+static ERL_NIF_TERM taos_stmt_use_result_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 1) {
+    return enif_make_badarg(env);
+  }
+  taos_stmt_t* stmt_ptr = NULL;
+  if(!get_stmt(env, argv[0], &stmt_ptr)){
+    return enif_make_tuple2(env, atom_error, atom_invalid_resource);
+  };
+  TAOS_RES* res = taos_stmt_use_result(stmt_ptr->stmt);
+  if(res == NULL) return enif_make_tuple2(env, atom_error, atom_invalid_resource);
+  taos_res_t* res_ptr = (taos_res_t*)enif_alloc_resource(TAOS_RES_TYPE, sizeof(taos_res_t));
+  res_ptr->taos_res = res;
+  res_ptr->taos_row = NULL;
+  res_ptr->stoppers = 0;
+  res_ptr->conn = stmt_ptr->conn;
+  res_ptr->stmt = stmt_ptr;
+  __atomic_add_fetch(&stmt_ptr->results, 1, __ATOMIC_SEQ_CST);
+  enif_keep_resource(stmt_ptr->conn);
+  enif_keep_resource(stmt_ptr);
+  STAT_ADD(live_res, 1);
+  ERL_NIF_TERM term = enif_make_resource(env, res_ptr);
+  enif_release_resource(res_ptr);
+  return enif_make_tuple2(env, atom_ok, term);
+}
+
 static ERL_NIF_TERM taos_stmt_execute_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
   if (argc != 1) {
     return enif_make_badarg(env);
   }
   taos_stmt_t* stmt_ptr = NULL;
-  if(!enif_get_resource(env, argv[0], TAOS_STMT_TYPE, (void**) &stmt_ptr)){
+  if(!get_stmt(env, argv[0], &stmt_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
   int exc_res = taos_stmt_execute(stmt_ptr->stmt);
@@ -158,12 +707,8 @@ static ERL_NIF_TERM taos_stmt_close_nif(ErlNifEnv* env, int argc, const ERL_NIF_
   if(!enif_get_resource(env, argv[0], TAOS_STMT_TYPE, (void**) &stmt_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
-  taos_stmt_close(stmt_ptr->stmt);
-  if(stmt_ptr->params){
-    free_parm(stmt_ptr->params, stmt_ptr->param_count);
-    free(stmt_ptr->params);
-    stmt_ptr->params = NULL;
-  }
+  __atomic_store_n(&stmt_ptr->closing, 1, __ATOMIC_SEQ_CST);
+  if(__atomic_load_n(&stmt_ptr->results, __ATOMIC_SEQ_CST) == 0) close_stmt(stmt_ptr);
   return atom_ok;
 }
 
@@ -173,21 +718,24 @@ static ERL_NIF_TERM taos_multi_bind_set_timestamp_nif(ErlNifEnv* env, int argc,
   }
   taos_stmt_t* stmt_ptr = NULL;
   uint index;
-  if(!enif_get_resource(env, argv[0], TAOS_STMT_TYPE, (void**) &stmt_ptr)){
+  if(!get_stmt(env, argv[0], &stmt_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
-  if(!enif_get_uint(env, argv[1], &index)){
+  if(!enif_get_uint(env, argv[1], &index) || index >= (uint)stmt_ptr->param_count){
     return enif_make_badarg(env);
   };
-  ulong *buffer = (ulong*)malloc(bintLen);
-  if(!enif_get_ulong(env, argv[2], buffer)){
+  ErlNifSInt64* buffer = (ErlNifSInt64*)malloc(bintLen);
+  if(!enif_get_int64(env, argv[2], buffer)){
     free(buffer);
     return enif_make_badarg(env);
   };
   
   int32_t* len_ptr = (int32_t*)malloc(sizeof(int32_t));
   *len_ptr = bintLen;
+  STAT_ADD(bind_allocs, 1);
+  STAT_ADD(live_binds, 1);
   TAOS_MULTI_BIND* params = stmt_ptr->params + index;
+  free_parm(params, 1);
   params->buffer_type = TSDB_DATA_TYPE_TIMESTAMP;
   params->buffer_length = bintLen;
   params->buffer = buffer;
@@ -203,10 +751,10 @@ static ERL_NIF_TERM taos_multi_bind_set_int_nif(ErlNifEnv* env, int argc, const
   }
   taos_stmt_t* stmt_ptr = NULL;
   uint index;
-  if(!enif_get_resource(env, argv[0], TAOS_STMT_TYPE, (void**) &stmt_ptr)){
+  if(!get_stmt(env, argv[0], &stmt_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
-  if(!enif_get_uint(env, argv[1], &index)){
+  if(!enif_get_uint(env, argv[1], &index) || index >= (uint)stmt_ptr->param_count){
     return enif_make_badarg(env);
   };
   int32_t* buffer = (int32_t*)malloc(intLen);
@@ -216,7 +764,10 @@ static ERL_NIF_TERM taos_multi_bind_set_int_nif(ErlNifEnv* env, int argc, const
   };
   int32_t* len_ptr = (int32_t*)malloc(sizeof(int32_t));
   *len_ptr = intLen;
+  STAT_ADD(bind_allocs, 1);
+  STAT_ADD(live_binds, 1);
   TAOS_MULTI_BIND* params = stmt_ptr->params + index;
+  free_parm(params, 1);
   params->buffer_type = TSDB_DATA_TYPE_INT;
   params->buffer_length = intLen;
   params->buffer = buffer;
@@ -232,20 +783,23 @@ static ERL_NIF_TERM taos_multi_bind_set_long_nif(ErlNifEnv* env, int argc, const
   }
   taos_stmt_t* stmt_ptr = NULL;
   uint index;
-  if(!enif_get_resource(env, argv[0], TAOS_STMT_TYPE, (void**) &stmt_ptr)){
+  if(!get_stmt(env, argv[0], &stmt_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
-  if(!enif_get_uint(env, argv[1], &index)){
+  if(!enif_get_uint(env, argv[1], &index) || index >= (uint)stmt_ptr->param_count){
     return enif_make_badarg(env);
   };
-  int64_t* buffer = (int64_t*)malloc(intLen);
-  if(!enif_get_long(env, argv[2], buffer)){
+  int64_t* buffer = (int64_t*)malloc(bintLen);
+  if(!enif_get_int64(env, argv[2], (ErlNifSInt64*)buffer)){
     free(buffer);
     return enif_make_badarg(env);
   };
   int32_t* len_ptr = (int32_t*)malloc(sizeof(int32_t));
   *len_ptr = bintLen;
+  STAT_ADD(bind_allocs, 1);
+  STAT_ADD(live_binds, 1);
   TAOS_MULTI_BIND* params = stmt_ptr->params + index;
+  free_parm(params, 1);
   params->buffer_type = TSDB_DATA_TYPE_BIGINT;
   params->buffer_length = bintLen;
   params->buffer = buffer;
@@ -261,10 +815,10 @@ static ERL_NIF_TERM taos_multi_bind_set_short_nif(ErlNifEnv* env, int argc, cons
   }
   taos_stmt_t* stmt_ptr = NULL;
   uint index;
-  if(!enif_get_resource(env, argv[0], TAOS_STMT_TYPE, (void**) &stmt_ptr)){
+  if(!get_stmt(env, argv[0], &stmt_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
-  if(!enif_get_uint(env, argv[1], &index)){
+  if(!enif_get_uint(env, argv[1], &index) || index >= (uint)stmt_ptr->param_count){
     return enif_make_badarg(env);
   };
   int value;
@@ -275,7 +829,10 @@ static ERL_NIF_TERM taos_multi_bind_set_short_nif(ErlNifEnv* env, int argc, cons
   *buffer = (int16_t)value;
   int32_t* len_ptr = (int32_t*)malloc(sizeof(int32_t));
   *len_ptr = sintLen;
+  STAT_ADD(bind_allocs, 1);
+  STAT_ADD(live_binds, 1);
   TAOS_MULTI_BIND* params = stmt_ptr->params + index;
+  free_parm(params, 1);
   params->buffer_type = TSDB_DATA_TYPE_SMALLINT;
   params->buffer_length = sintLen;
   params->buffer = buffer;
@@ -291,10 +848,10 @@ static ERL_NIF_TERM taos_multi_bind_set_bool_nif(ErlNifEnv* env, int argc, const
   }
   taos_stmt_t* stmt_ptr = NULL;
   uint index;
-  if(!enif_get_resource(env, argv[0], TAOS_STMT_TYPE, (void**) &stmt_ptr)){
+  if(!get_stmt(env, argv[0], &stmt_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
-  if(!enif_get_uint(env, argv[1], &index)){
+  if(!enif_get_uint(env, argv[1], &index) || index >= (uint)stmt_ptr->param_count){
     return enif_make_badarg(env);
   };
   uint value;
@@ -305,7 +862,10 @@ static ERL_NIF_TERM taos_multi_bind_set_bool_nif(ErlNifEnv* env, int argc, const
   *buffer = (int8_t)value;
   int32_t* len_ptr = (int32_t*)malloc(sizeof(int32_t));
   *len_ptr = boolLen;
+  STAT_ADD(bind_allocs, 1);
+  STAT_ADD(live_binds, 1);
   TAOS_MULTI_BIND* params = stmt_ptr->params + index;
+  free_parm(params, 1);
   params->buffer_type = TSDB_DATA_TYPE_BOOL;
   params->buffer_length = boolLen;
   params->buffer = buffer;
@@ -321,10 +881,10 @@ static ERL_NIF_TERM taos_multi_bind_set_byte_nif(ErlNifEnv* env, int argc, const
   }
   taos_stmt_t* stmt_ptr = NULL;
   uint index;
-  if(!enif_get_resource(env, argv[0], TAOS_STMT_TYPE, (void**) &stmt_ptr)){
+  if(!get_stmt(env, argv[0], &stmt_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
-  if(!enif_get_uint(env, argv[1], &index)){
+  if(!enif_get_uint(env, argv[1], &index) || index >= (uint)stmt_ptr->param_count){
     return enif_make_badarg(env);
   };
   int value;
@@ -335,7 +895,10 @@ static ERL_NIF_TERM taos_multi_bind_set_byte_nif(ErlNifEnv* env, int argc, const
   *buffer = (int8_t)value;
   int32_t* len_ptr = (int32_t*)malloc(sizeof(int32_t));
   *len_ptr = boolLen;
+  STAT_ADD(bind_allocs, 1);
+  STAT_ADD(live_binds, 1);
   TAOS_MULTI_BIND* params = stmt_ptr->params + index;
+  free_parm(params, 1);
   params->buffer_type = TSDB_DATA_TYPE_TINYINT;
   params->buffer_length = boolLen;
   params->buffer = buffer;
@@ -351,10 +914,10 @@ static ERL_NIF_TERM taos_multi_bind_set_float_nif(ErlNifEnv* env, int argc, cons
   }
   taos_stmt_t* stmt_ptr = NULL;
   uint index;
-  if(!enif_get_resource(env, argv[0], TAOS_STMT_TYPE, (void**) &stmt_ptr)){
+  if(!get_stmt(env, argv[0], &stmt_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
-  if(!enif_get_uint(env, argv[1], &index)){
+  if(!enif_get_uint(env, argv[1], &index) || index >= (uint)stmt_ptr->param_count){
     return enif_make_badarg(env);
   };
   double value;
@@ -365,7 +928,10 @@ static ERL_NIF_TERM taos_multi_bind_set_float_nif(ErlNifEnv* env, int argc, cons
   *buffer = (float)value;
   int32_t* len_ptr = (int32_t*)malloc(sizeof(int32_t));
   *len_ptr = floatLen;
+  STAT_ADD(bind_allocs, 1);
+  STAT_ADD(live_binds, 1);
   TAOS_MULTI_BIND* params = stmt_ptr->params + index;
+  free_parm(params, 1);
   params->buffer_type = TSDB_DATA_TYPE_FLOAT;
   params->buffer_length = floatLen;
   params->buffer = buffer;
@@ -381,10 +947,10 @@ static ERL_NIF_TERM taos_multi_bind_set_double_nif(ErlNifEnv* env, int argc, con
   }
   taos_stmt_t* stmt_ptr = NULL;
   uint index;
-  if(!enif_get_resource(env, argv[0], TAOS_STMT_TYPE, (void**) &stmt_ptr)){
+  if(!get_stmt(env, argv[0], &stmt_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
-  if(!enif_get_uint(env, argv[1], &index)){
+  if(!enif_get_uint(env, argv[1], &index) || index >= (uint)stmt_ptr->param_count){
     return enif_make_badarg(env);
   };
   double* buffer = (double*)malloc(doubleLen);
@@ -394,7 +960,10 @@ static ERL_NIF_TERM taos_multi_bind_set_double_nif(ErlNifEnv* env, int argc, con
   };
   int32_t* len_ptr = (int32_t*)malloc(sizeof(int32_t));
   *len_ptr = doubleLen;
+  STAT_ADD(bind_allocs, 1);
+  STAT_ADD(live_binds, 1);
   TAOS_MULTI_BIND* params = stmt_ptr->params + index;
+  free_parm(params, 1);
   params->buffer_type = TSDB_DATA_TYPE_DOUBLE;
   params->buffer_length = doubleLen;
   params->buffer = buffer;
@@ -410,10 +979,10 @@ static ERL_NIF_TERM taos_multi_bind_set_varbinary_nif(ErlNifEnv* env, int argc,
   }
   taos_stmt_t* stmt_ptr = NULL;
   uint index;
-  if(!enif_get_resource(env, argv[0], TAOS_STMT_TYPE, (void**) &stmt_ptr)){
+  if(!get_stmt(env, argv[0], &stmt_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
-  if(!enif_get_uint(env, argv[1], &index)){
+  if(!enif_get_uint(env, argv[1], &index) || index >= (uint)stmt_ptr->param_count){
     return enif_make_badarg(env);
   };
   ErlNifBinary bin;
@@ -424,7 +993,10 @@ static ERL_NIF_TERM taos_multi_bind_set_varbinary_nif(ErlNifEnv* env, int argc,
   int32_t* len_ptr = (int32_t*)malloc(sizeof(int32_t));
   *len_ptr = bin.size;
   memcpy(buffer, bin.data, *len_ptr);
+  STAT_ADD(bind_allocs, 1);
+  STAT_ADD(live_binds, 1);
   TAOS_MULTI_BIND* params = stmt_ptr->params + index;
+  free_parm(params, 1);
   params->buffer_type = TSDB_DATA_TYPE_VARBINARY;
   params->buffer_length = bin.size;
   params->buffer = buffer;
@@ -440,10 +1012,10 @@ static ERL_NIF_TERM taos_multi_bind_set_varchar_nif(ErlNifEnv* env, int argc, co
   }
   taos_stmt_t* stmt_ptr = NULL;
   uint index;
-  if(!enif_get_resource(env, argv[0], TAOS_STMT_TYPE, (void**) &stmt_ptr)){
+  if(!get_stmt(env, argv[0], &stmt_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
-  if(!enif_get_uint(env, argv[1], &index)){
+  if(!enif_get_uint(env, argv[1], &index) || index >= (uint)stmt_ptr->param_count){
     return enif_make_badarg(env);
   };
   ErlNifBinary bin;
@@ -454,7 +1026,10 @@ static ERL_NIF_TERM taos_multi_bind_set_varchar_nif(ErlNifEnv* env, int argc, co
   int32_t* len_ptr = (int32_t*)malloc(sizeof(int32_t));
   *len_ptr = bin.size;
   memcpy(buffer, bin.data, *len_ptr);
+  STAT_ADD(bind_allocs, 1);
+  STAT_ADD(live_binds, 1);
   TAOS_MULTI_BIND* params = stmt_ptr->params + index;
+  free_parm(params, 1);
   params->buffer_type = TSDB_DATA_TYPE_VARCHAR;
   params->buffer_length = bin.size;
   params->buffer = buffer;
@@ -498,8 +1073,11 @@ static ERL_NIF_TERM taos_connect_nif(ErlNifEnv* env, int argc, const ERL_NIF_TER
     return enif_make_tuple2(env, atom_error, atom_error_connect);
   }
   taos_options(TSDB_OPTION_TIMEZONE, "UTC");
+  STAT_ADD(live_conn, 1);
   taos_ptr = (taos_t*)enif_alloc_resource(TAOS_TYPE, sizeof(taos_t));
   taos_ptr->taos = taos;
+  taos_ptr->children = 0;
+  taos_ptr->closing = 0;
   ERL_NIF_TERM connect = enif_make_resource(env, taos_ptr);
   enif_release_resource(taos_ptr);
   return enif_make_tuple2(env, atom_ok, connect);
@@ -516,7 +1094,7 @@ static ERL_NIF_TERM taos_close_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
 
-  taos_close(taos_ptr->taos);
+  close_taos(taos_ptr);
   return atom_ok;
 }
 
@@ -527,11 +1105,31 @@ static ERL_NIF_TERM taos_kill_query_nif(ErlNifEnv* env, int argc, const ERL_NIF_
 
   taos_t* taos_ptr = NULL;
 
-  if(!enif_get_resource(env, argv[0], TAOS_TYPE, (void**) &taos_ptr)){
+  if(!get_taos(env, argv[0], &taos_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
 
-  taos_kill_query(taos_ptr->taos);
+  TAOS* taos = conn_acquire(taos_ptr);
+  if(taos == NULL){
+    return enif_make_tuple2(env, atom_error, atom_invalid_resource);
+  }
+  taos_kill_query(taos);
+  conn_release(taos_ptr);
+  return atom_ok;
+}
+
+static ERL_NIF_TERM taos_stop_query_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if(argc != 1) {
+    return enif_make_badarg(env);
+  }
+
+  taos_res_t* res_ptr = NULL;
+
+  if(!enif_get_resource(env, argv[0], TAOS_RES_TYPE, (void**) &res_ptr)){
+    return enif_make_tuple2(env, atom_error, atom_invalid_resource);
+  };
+
+  stop_res(res_ptr);
   return atom_ok;
 }
 
@@ -543,7 +1141,7 @@ static ERL_NIF_TERM taos_select_db_nif(ErlNifEnv* env, int argc, const ERL_NIF_T
   taos_t* taos_ptr = NULL;
   char db[256];
 
-  if(!enif_get_resource(env, argv[0], TAOS_TYPE, (void**) &taos_ptr)){
+  if(!get_taos(env, argv[0], &taos_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
 
@@ -551,7 +1149,12 @@ static ERL_NIF_TERM taos_select_db_nif(ErlNifEnv* env, int argc, const ERL_NIF_T
     return enif_make_badarg(env);
   };
 
-  int res = taos_select_db(taos_ptr->taos, db);
+  TAOS* taos = conn_acquire(taos_ptr);
+  if(taos == NULL){
+    return enif_make_tuple2(env, atom_error, atom_invalid_resource);
+  }
+  int res = taos_select_db(taos, db);
+  conn_release(taos_ptr);
   return enif_make_tuple2(env, atom_ok, enif_make_int(env, res));
 }
 
@@ -565,7 +1168,7 @@ static ERL_NIF_TERM taos_query_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM
   taos_res_t* res_ptr = NULL;
   
 
-  if(!enif_get_resource(env, argv[0], TAOS_TYPE, (void**) &taos_ptr)){
+  if(!get_taos(env, argv[0], &taos_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
 
@@ -577,8 +1180,23 @@ static ERL_NIF_TERM taos_query_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM
     return enif_make_badarg(env);
   };
 
+  TAOS* taos = conn_acquire(taos_ptr);
+  if(taos == NULL){
+    return enif_make_tuple2(env, atom_error, atom_invalid_resource);
+  }
+  TAOS_RES* taos_res = taos_query(taos, sql);
+  if(taos_res == NULL){
+    conn_release(taos_ptr);
+    return enif_make_tuple2(env, atom_error, atom_less_memory);
+  }
   res_ptr = (taos_res_t*)enif_alloc_resource(TAOS_RES_TYPE, sizeof(taos_res_t));
-  res_ptr->taos_res = taos_query(taos_ptr->taos, sql);
+  res_ptr->taos_res = taos_res;
+  res_ptr->taos_row = NULL;
+  res_ptr->stoppers = 0;
+  res_ptr->conn = taos_ptr;
+  res_ptr->stmt = NULL;
+  enif_keep_resource(taos_ptr);
+  STAT_ADD(live_res, 1);
   ERL_NIF_TERM res = enif_make_resource(env, res_ptr);
   enif_release_resource(res_ptr);
   return enif_make_tuple2(env, atom_ok, res);
@@ -590,7 +1208,7 @@ static ERL_NIF_TERM taos_affected_rows_nif(ErlNifEnv* env, int argc, const ERL_N
   }
 
   taos_res_t* res_ptr = NULL;
-  if(!enif_get_resource(env, argv[0], TAOS_RES_TYPE, (void**) &res_ptr)){
+  if(!get_res(env, argv[0], &res_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
 
@@ -604,7 +1222,7 @@ static ERL_NIF_TERM taos_result_precision_nif(ErlNifEnv* env, int argc, const ER
   }
 
   taos_res_t* res_ptr = NULL;
-  if(!enif_get_resource(env, argv[0], TAOS_RES_TYPE, (void**) &res_ptr)){
+  if(!get_res(env, argv[0], &res_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
 
@@ -612,48 +1230,39 @@ static ERL_NIF_TERM taos_result_precision_nif(ErlNifEnv* env, int argc, const ER
   return enif_make_tuple2(env, atom_ok, enif_make_int(env, precision));
 }
 
+/* The current row lives in the result resource, a TAOS_ROW is only valid
+ * until the next fetch on the same result anyway. */
 static ERL_NIF_TERM taos_fetch_row_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
   if (argc != 1) {
     return enif_make_badarg(env);
   }
 
   taos_res_t* res_ptr = NULL;
-  taos_row_t* row_ptr = NULL;
 
-  if(!enif_get_resource(env, argv[0], TAOS_RES_TYPE, (void**) &res_ptr)){
+  if(!get_res(env, argv[0], &res_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
 
-  row_ptr = (taos_row_t*)enif_alloc_resource(TAOS_ROW_TYPE, sizeof(taos_row_t));
-  row_ptr->taos_row = taos_fetch_row(res_ptr->taos_res);
-  ERL_NIF_TERM row = enif_make_resource(env, row_ptr);
-  enif_release_resource(row_ptr);
-  return enif_make_tuple2(env, atom_ok, row);
+  res_ptr->taos_row = taos_fetch_row(res_ptr->taos_res);
+  if(res_ptr->taos_row == NULL) return enif_make_tuple2(env, atom_ok, atom_nil);
+  return enif_make_tuple2(env, atom_ok, argv[0]);
 }
 
 static ERL_NIF_TERM taos_print_row_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
-  if (argc != 3) {
+  if (argc != 1) {
     return enif_make_badarg(env);
   }
 
   char str[1024];
-  taos_row_t* row_ptr = NULL;
-  taos_field_t* field_ptr = NULL;
-  int num_fields;
-
-  if(!enif_get_resource(env, argv[0], TAOS_ROW_TYPE, (void**) &row_ptr)){
-    return enif_make_tuple2(env, atom_error, atom_invalid_resource);
-  };
+  taos_res_t* res_ptr = NULL;
 
-  if(!enif_get_resource(env, argv[1], TAOS_FIELD_TYPE, (void**) &field_ptr)){
+  if(!get_res(env, argv[0], &res_ptr) || res_ptr->taos_row == NULL){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
 
-  if(!enif_get_int(env, argv[2], &num_fields)){
-    return enif_make_badarg(env);
-  };
-
-  taos_print_row(str, row_ptr->taos_row, field_ptr->taos_field, num_fields);
+  TAOS_FIELD* fields = taos_fetch_fields(res_ptr->taos_res);
+  int num_fields = taos_field_count(res_ptr->taos_res);
+  taos_print_row(str, res_ptr->taos_row, fields, num_fields);
   return enif_make_tuple2(env, atom_ok, enif_make_string(env, str, ERL_NIF_LATIN1));
 }
 
@@ -663,7 +1272,7 @@ static ERL_NIF_TERM taos_field_count_nif(ErlNifEnv* env, int argc, const ERL_NIF
   }
 
   taos_res_t* res_ptr = NULL;
-  if(!enif_get_resource(env, argv[0], TAOS_RES_TYPE, (void**) &res_ptr)){
+  if(!get_res(env, argv[0], &res_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
 
@@ -679,9 +1288,8 @@ static ERL_NIF_TERM taos_fetch_raw_block_nif(ErlNifEnv* env, int argc, const ERL
   taos_res_t* res_ptr = NULL;
   int num_of_rows = 0;
   void* pg_data;
-  ErlNifBinary bin;
 
-  if(!enif_get_resource(env, argv[0], TAOS_RES_TYPE, (void**) &res_ptr)){
+  if(!get_res(env, argv[0], &res_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
 
@@ -695,20 +1303,11 @@ static ERL_NIF_TERM taos_fetch_raw_block_nif(ErlNifEnv* env, int argc, const ERL
   }
 
   if(code == 0){
-    unsigned char sizeArr[9] = {0};
-    int size = 0;
-    memcpy(sizeArr, pg_data + 4, 4);
-    memcpy(&size, sizeArr, 4);
-    enif_alloc_binary(size, &bin);
-    memcpy(bin.data, pg_data, size);
-
-    ERL_NIF_TERM block_bin = enif_make_binary(env, &bin);
-    enif_release_binary(&bin);
     return enif_make_tuple3(
       env, 
       atom_ok, 
       enif_make_int(env, num_of_rows),
-      block_bin
+      make_raw_block(env, pg_data)
     );
   } else {
     const char* err_str = taos_errstr(res_ptr->taos_res);
@@ -730,7 +1329,7 @@ static ERL_NIF_TERM taos_free_result_nif(ErlNifEnv* env, int argc, const ERL_NIF
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
 
-  taos_free_result(res_ptr->taos_res);
+  free_res(res_ptr);
   return atom_ok;
 }
 
@@ -752,7 +1351,7 @@ static ERL_NIF_TERM taos_fetch_fields_nif(ErlNifEnv* env, int argc, const ERL_NI
   taos_res_t* res_ptr = NULL;
   ErlNifBinary bin;
 
-  if(!enif_get_resource(env, argv[0], TAOS_RES_TYPE, (void**) &res_ptr)){
+  if(!get_res(env, argv[0], &res_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
 
@@ -773,7 +1372,7 @@ static ERL_NIF_TERM taos_errstr_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM
   }
 
   taos_res_t* res_ptr = NULL;
-  if(!enif_get_resource(env, argv[0], TAOS_RES_TYPE, (void**) &res_ptr)){
+  if(!get_res(env, argv[0], &res_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
 
@@ -787,7 +1386,7 @@ static ERL_NIF_TERM taos_errno_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM
   }
 
   taos_res_t* res_ptr = NULL;
-  if(!enif_get_resource(env, argv[0], TAOS_RES_TYPE, (void**) &res_ptr)){
+  if(!get_res(env, argv[0], &res_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
 
@@ -805,7 +1404,7 @@ static ERL_NIF_TERM taos_query_a_nif(ErlNifEnv* env, int argc, const ERL_NIF_TER
 
   taos_t* taos_ptr = NULL;
   char sql[256];
-  if(!enif_get_resource(env, argv[0], TAOS_TYPE, (void**) &taos_ptr)){
+  if(!get_taos(env, argv[0], &taos_ptr)){
     return enif_make_tuple2(env, atom_error, atom_invalid_resource);
   };
 
@@ -813,40 +1412,418 @@ static ERL_NIF_TERM taos_query_a_nif(ErlNifEnv* env, int argc, const ERL_NIF_TER
     return enif_make_badarg(env);
   };
 
-  taos_query_a(taos_ptr->taos, sql, NULL, NULL);
+  TAOS* taos = conn_acquire(taos_ptr);
+  if(taos == NULL){
+    return enif_make_tuple2(env, atom_error, atom_invalid_resource);
+  }
+  taos_query_a(taos, sql, NULL, NULL);
+  conn_release(taos_ptr);
   return atom_ok;
 }
 
 
 
-static void free_taos_resource(ErlNifEnv* env, void* obj) {
+static ERL_NIF_TERM taos_stats_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 0) {
+    return enif_make_badarg(env);
+  }
 
+  ERL_NIF_TERM keys[] = {
+    enif_make_atom(env, "blocks"),
+    enif_make_atom(env, "bytes"),
+    enif_make_atom(env, "live_conn"),
+    enif_make_atom(env, "live_res"),
+    enif_make_atom(env, "live_stmt"),
+    enif_make_atom(env, "live_tmq"),
+    enif_make_atom(env, "bind_allocs"),
+    enif_make_atom(env, "live_binds"),
+    enif_make_atom(env, "gc_conn"),
+    enif_make_atom(env, "gc_res"),
+    enif_make_atom(env, "gc_stmt")
+  };
+  ERL_NIF_TERM values[] = {
+    enif_make_uint64(env, STAT_GET(blocks)),
+    enif_make_uint64(env, STAT_GET(bytes)),
+    enif_make_int64(env, STAT_GET(live_conn)),
+    enif_make_int64(env, STAT_GET(live_res)),
+    enif_make_int64(env, STAT_GET(live_stmt)),
+    enif_make_int64(env, STAT_GET(live_tmq)),
+    enif_make_uint64(env, STAT_GET(bind_allocs)),
+    enif_make_int64(env, STAT_GET(live_binds)),
+    enif_make_uint64(env, STAT_GET(gc_conn)),
+    enif_make_uint64(env, STAT_GET(gc_res)),
+    enif_make_uint64(env, STAT_GET(gc_stmt))
+  };
+  ERL_NIF_TERM result;
+  enif_make_map_from_arrays(env, keys, values, sizeof(keys) / sizeof(keys[0]), &result);
+  return result;
+}
+
+/* TMQ (data subscription) APIs */
+static ERL_NIF_TERM make_tmq_message(ErlNifEnv* env, taos_tmq_t* tmq_ptr, TAOS_RES* msg) {
+  ERL_NIF_TERM blocks = enif_make_list(env, 0);
+  for(;;){
+    int num_of_rows = 0;
+    void* pg_data = NULL;
+    int code = taos_fetch_raw_block(msg, &num_of_rows, &pg_data);
+    if(code != 0 || num_of_rows == 0 || pg_data == NULL) break;
+
+    const char* table = tmq_get_table_name(msg);
+    int field_count = taos_field_count(msg);
+    TAOS_FIELD* fields = taos_fetch_fields(msg);
+    ErlNifBinary fields_bin;
+    enif_alloc_binary(field_count * sizeof(TAOS_FIELD), &fields_bin);
+    memcpy(fields_bin.data, fields, field_count * sizeof(TAOS_FIELD));
+    ERL_NIF_TERM fields_term = enif_make_binary(env, &fields_bin);
+    enif_release_binary(&fields_bin);
+
+    ERL_NIF_TERM block = enif_make_tuple3(
+      env,
+      table ? make_string(env, (char*)table) : atom_nil,
+      fields_term,
+      make_raw_block(env, pg_data)
+    );
+    blocks = enif_make_list_cell(env, block, blocks);
+  }
+  enif_make_reverse_list(env, blocks, &blocks);
+
+  const char* topic = tmq_get_topic_name(msg);
+  const char* db = tmq_get_db_name(msg);
+  ERL_NIF_TERM keys[] = {
+    atom_struct, atom_consumer, atom_topic, atom_database,
+    atom_vgroup_id, atom_offset, atom_precision, atom_blocks
+  };
+  ERL_NIF_TERM values[] = {
+    atom_tmq_message,
+    enif_make_pid(env, &tmq_ptr->owner),
+    topic ? make_string(env, (char*)topic) : atom_nil,
+    db ? make_string(env, (char*)db) : atom_nil,
+    enif_make_int(env, tmq_get_vgroup_id(msg)),
+    enif_make_int64(env, tmq_get_vgroup_offset(msg)),
+    enif_make_int(env, taos_result_precision(msg)),
+    blocks
+  };
+  ERL_NIF_TERM message;
+  enif_make_map_from_arrays(env, keys, values, 8, &message);
+  return enif_make_tuple3(env, atom_tdex_tmq, enif_make_pid(env, &tmq_ptr->owner), message);
+}
+
+static void* tmq_poll_thread(void* arg) {
+  taos_tmq_t* tmq_ptr = (taos_tmq_t*)arg;
+  ErlNifEnv* msg_env = enif_alloc_env();
+  for(;;){
+    enif_mutex_lock(tmq_ptr->lock);
+    while(tmq_ptr->running && tmq_ptr->demand == 0){
+      enif_cond_wait(tmq_ptr->cond, tmq_ptr->lock);
+    }
+    if(!tmq_ptr->running){
+      enif_mutex_unlock(tmq_ptr->lock);
+      break;
+    }
+    enif_mutex_unlock(tmq_ptr->lock);
+
+    TAOS_RES* msg = tmq_consumer_poll(tmq_ptr->tmq, tmq_ptr->timeout);
+    if(msg == NULL) continue;
+    ERL_NIF_TERM term = make_tmq_message(msg_env, tmq_ptr, msg);
+    taos_free_result(msg);
+
+    enif_mutex_lock(tmq_ptr->lock);
+    tmq_ptr->demand--;
+    enif_mutex_unlock(tmq_ptr->lock);
+    enif_send(NULL, &tmq_ptr->subscriber, msg_env, term);
+    enif_clear_env(msg_env);
+  }
+  enif_free_env(msg_env);
+  enif_mutex_lock(tmq_ptr->lock);
+  tmq_ptr->alive = 0;
+  enif_cond_broadcast(tmq_ptr->cond);
+  enif_mutex_unlock(tmq_ptr->lock);
+  /* may run the destructor on this thread, tmq_ptr is not touched after it */
+  enif_release_resource(tmq_ptr);
+  return NULL;
+}
+
+/* Asks the poll thread to stop; with `wait` blocks until it is out of the
+ * consumer for good (only from dirty NIFs). */
+static void tmq_stop_thread(taos_tmq_t* tmq_ptr, int wait) {
+  enif_mutex_lock(tmq_ptr->lock);
+  tmq_ptr->running = 0;
+  enif_cond_broadcast(tmq_ptr->cond);
+  while(wait && tmq_ptr->alive) enif_cond_wait(tmq_ptr->cond, tmq_ptr->lock);
+  enif_mutex_unlock(tmq_ptr->lock);
+}
+
+static int tmq_start_thread(taos_tmq_t* tmq_ptr) {
+  pthread_t tid;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  enif_keep_resource(tmq_ptr);
+  int err = pthread_create(&tid, &attr, tmq_poll_thread, tmq_ptr);
+  pthread_attr_destroy(&attr);
+  if(err) enif_release_resource(tmq_ptr);
+  return err;
+}
+
+static ERL_NIF_TERM tmq_consumer_new_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 1) {
+    return enif_make_badarg(env);
+  }
+
+  char key[256], value[256], errstr[512];
+  int arity;
+  const ERL_NIF_TERM* kv;
+  ERL_NIF_TERM head, tail = argv[0];
+  tmq_conf_t* conf = tmq_conf_new();
+  while(enif_get_list_cell(env, tail, &head, &tail)){
+    if(!enif_get_tuple(env, head, &arity, &kv) || arity != 2
+      || !enif_get_string(env, kv[0], key, sizeof(key), ERL_NIF_LATIN1)
+      || !enif_get_string(env, kv[1], value, sizeof(value), ERL_NIF_LATIN1)){
+      tmq_conf_destroy(conf);
+      return enif_make_badarg(env);
+    }
+    if(tmq_conf_set(conf, key, value) != TMQ_CONF_OK){
+      tmq_conf_destroy(conf);
+      return enif_make_tuple2(env, atom_error, enif_make_string(env, key, ERL_NIF_LATIN1));
+    }
+  }
+
+  errstr[0] = 0;
+  tmq_t* tmq = tmq_consumer_new(conf, errstr, sizeof(errstr));
+  tmq_conf_destroy(conf);
+  if(tmq == NULL){
+    return enif_make_tuple2(env, atom_error, make_string(env, errstr));
+  }
+
+  STAT_ADD(live_tmq, 1);
+  taos_tmq_t* tmq_ptr = (taos_tmq_t*)enif_alloc_resource(TMQ_TYPE, sizeof(taos_tmq_t));
+  memset(tmq_ptr, 0, sizeof(taos_tmq_t));
+  tmq_ptr->tmq = tmq;
+  tmq_ptr->lock = enif_mutex_create("tdex_tmq_lock");
+  tmq_ptr->cond = enif_cond_create("tdex_tmq_cond");
+  ERL_NIF_TERM result = enif_make_resource(env, tmq_ptr);
+  enif_release_resource(tmq_ptr);
+  return enif_make_tuple2(env, atom_ok, result);
+}
+
+static ERL_NIF_TERM tmq_subscribe_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 2) {
+    return enif_make_badarg(env);
+  }
+
+  taos_tmq_t* tmq_ptr = NULL;
+  if(!enif_get_resource(env, argv[0], TMQ_TYPE, (void**) &tmq_ptr) || tmq_ptr->tmq == NULL){
+    return enif_make_tuple2(env, atom_error, atom_invalid_resource);
+  };
+
+  char topic[256];
+  ERL_NIF_TERM head, tail = argv[1];
+  tmq_list_t* topics = tmq_list_new();
+  while(enif_get_list_cell(env, tail, &head, &tail)){
+    if(!enif_get_string(env, head, topic, sizeof(topic), ERL_NIF_LATIN1)){
+      tmq_list_destroy(topics);
+      return enif_make_badarg(env);
+    }
+    tmq_list_append(topics, topic);
+  }
+
+  int32_t code = tmq_subscribe(tmq_ptr->tmq, topics);
+  tmq_list_destroy(topics);
+  if(code){
+    return enif_make_tuple2(env, atom_error, enif_make_string(env, tmq_err2str(code), ERL_NIF_LATIN1));
+  }
+  return atom_ok;
+}
+
+static ERL_NIF_TERM tmq_consumer_start_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 3) {
+    return enif_make_badarg(env);
+  }
+
+  taos_tmq_t* tmq_ptr = NULL;
+  ErlNifPid subscriber;
+  ErlNifSInt64 timeout;
+  if(!enif_get_resource(env, argv[0], TMQ_TYPE, (void**) &tmq_ptr) || tmq_ptr->tmq == NULL){
+    return enif_make_tuple2(env, atom_error, atom_invalid_resource);
+  };
+  if(!enif_get_local_pid(env, argv[1], &subscriber)){
+    return enif_make_badarg(env);
+  };
+  if(!enif_get_int64(env, argv[2], &timeout)){
+    return enif_make_badarg(env);
+  };
+
+  enif_mutex_lock(tmq_ptr->lock);
+  if(tmq_ptr->running || tmq_ptr->alive){
+    enif_mutex_unlock(tmq_ptr->lock);
+    return enif_make_badarg(env);
+  }
+  enif_self(env, &tmq_ptr->owner);
+  tmq_ptr->subscriber = subscriber;
+  tmq_ptr->timeout = timeout;
+  tmq_ptr->running = 1;
+  tmq_ptr->alive = 1;
+  if(tmq_start_thread(tmq_ptr) != 0){
+    tmq_ptr->running = 0;
+    tmq_ptr->alive = 0;
+    enif_mutex_unlock(tmq_ptr->lock);
+    return enif_make_tuple2(env, atom_error, atom_less_memory);
+  }
+  enif_mutex_unlock(tmq_ptr->lock);
+  /* the thread keeps the resource alive, stop it when the owner goes away */
+  enif_monitor_process(env, tmq_ptr, &tmq_ptr->owner, &tmq_ptr->monitor);
+  return atom_ok;
+}
+
+static ERL_NIF_TERM tmq_consumer_ask_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 2) {
+    return enif_make_badarg(env);
+  }
+
+  taos_tmq_t* tmq_ptr = NULL;
+  int demand;
+  if(!enif_get_resource(env, argv[0], TMQ_TYPE, (void**) &tmq_ptr)){
+    return enif_make_tuple2(env, atom_error, atom_invalid_resource);
+  };
+  if(!enif_get_int(env, argv[1], &demand) || demand < 0){
+    return enif_make_badarg(env);
+  };
+
+  enif_mutex_lock(tmq_ptr->lock);
+  tmq_ptr->demand += demand;
+  enif_cond_signal(tmq_ptr->cond);
+  enif_mutex_unlock(tmq_ptr->lock);
+  return atom_ok;
+}
+
+static ERL_NIF_TERM tmq_commit_offset_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 4) {
+    return enif_make_badarg(env);
+  }
+
+  taos_tmq_t* tmq_ptr = NULL;
+  char topic[256];
+  int vgroup_id;
+  ErlNifSInt64 offset;
+  if(!enif_get_resource(env, argv[0], TMQ_TYPE, (void**) &tmq_ptr) || tmq_ptr->tmq == NULL){
+    return enif_make_tuple2(env, atom_error, atom_invalid_resource);
+  };
+  if(!enif_get_string(env, argv[1], topic, sizeof(topic), ERL_NIF_LATIN1)){
+    return enif_make_badarg(env);
+  };
+  if(!enif_get_int(env, argv[2], &vgroup_id) || !enif_get_int64(env, argv[3], &offset)){
+    return enif_make_badarg(env);
+  };
+
+  int32_t code = tmq_commit_offset_sync(tmq_ptr->tmq, topic, vgroup_id, offset);
+  if(code){
+    return enif_make_tuple2(env, atom_error, enif_make_string(env, tmq_err2str(code), ERL_NIF_LATIN1));
+  }
+  return atom_ok;
+}
+
+static ERL_NIF_TERM tmq_consumer_close_nif(ErlNifEnv* env, int argc, const ERL_NIF_TERM argv[]) {
+  if (argc != 1) {
+    return enif_make_badarg(env);
+  }
+
+  taos_tmq_t* tmq_ptr = NULL;
+  if(!enif_get_resource(env, argv[0], TMQ_TYPE, (void**) &tmq_ptr)){
+    return enif_make_tuple2(env, atom_error, atom_invalid_resource);
+  };
+
+  tmq_stop_thread(tmq_ptr, 1);
+  if(tmq_ptr->tmq){
+    tmq_unsubscribe(tmq_ptr->tmq);
+    tmq_consumer_close(tmq_ptr->tmq);
+    tmq_ptr->tmq = NULL;
+    STAT_ADD(live_tmq, -1);
+  }
+  return atom_ok;
+}
+
+static void* tmq_close_thread(void* arg) {
+  tmq_consumer_close((tmq_t*)arg);
+  STAT_ADD(live_tmq, -1);
+  return NULL;
+}
+
+/* Only runs once the poll thread has exited, it holds a reference until then.
+ * Consumers are closed by the owner's stop path (the dirty close NIF); one
+ * left open, e.g. by a killed owner, is closed on a detached thread because
+ * tmq_consumer_close does network round trips and the destructor may run on a
+ * scheduler. */
+static void free_tmq_resource(ErlNifEnv* env, void* obj) {
+  taos_tmq_t* tmq_ptr = (taos_tmq_t*)obj;
+  if(tmq_ptr->tmq){
+    pthread_t tid;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if(pthread_create(&tid, &attr, tmq_close_thread, tmq_ptr->tmq) != 0) tmq_close_thread(tmq_ptr->tmq);
+    pthread_attr_destroy(&attr);
+    tmq_ptr->tmq = NULL;
+  }
+  enif_cond_destroy(tmq_ptr->cond);
+  enif_mutex_destroy(tmq_ptr->lock);
+}
+
+static void tmq_owner_down(ErlNifEnv* env, void* obj, ErlNifPid* pid, ErlNifMonitor* mon) {
+  tmq_stop_thread((taos_tmq_t*)obj, 0);
+}
+
+static void free_taos_conn(ErlNifEnv* env, void* obj) {
+  taos_t* taos_ptr = (taos_t*)obj;
+  /* every child has released its reference by now */
+  if(taos_ptr->taos){
+    STAT_ADD(gc_conn, 1);
+    shut_taos(taos_ptr);
+  }
+}
+
+static void free_taos_res(ErlNifEnv* env, void* obj) {
+  taos_res_t* res_ptr = (taos_res_t*)obj;
+  if(free_res(res_ptr)) STAT_ADD(gc_res, 1);
+  if(res_ptr->stmt){
+    enif_release_resource(res_ptr->stmt);
+    res_ptr->stmt = NULL;
+  }
+  if(res_ptr->conn){
+    enif_release_resource(res_ptr->conn);
+    res_ptr->conn = NULL;
+  }
+}
+
+static void free_taos_stmt(ErlNifEnv* env, void* obj) {
+  taos_stmt_t* stmt_ptr = (taos_stmt_t*)obj;
+  if(close_stmt(stmt_ptr)) STAT_ADD(gc_stmt, 1);
+  if(stmt_ptr->conn){
+    enif_release_resource(stmt_ptr->conn);
+    stmt_ptr->conn = NULL;
+  }
 }
 
 static inline int init_taos_resource(ErlNifEnv* env) {
   const char* mod_taos = "TDEX";
   const char* name_taos = "TAOS_TYPE";
   const char* name_res_taos = "TAOS_RES_TYPE";
-  const char* name_row_taos = "TAOS_ROW_TYPE";
-  const char* name_field_taos = "TAOS_FIELD_TYPE";
   const char* name_stmt_type = "TAOS_STMT_TYPE";
+  const char* name_tmq_type = "TMQ_TYPE";
   int flags = ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER;
 
-  TAOS_TYPE = enif_open_resource_type(env, mod_taos, name_taos, free_taos_resource, (ErlNifResourceFlags)flags, NULL);
+  TAOS_TYPE = enif_open_resource_type(env, mod_taos, name_taos, free_taos_conn, (ErlNifResourceFlags)flags, NULL);
   if(TAOS_TYPE == NULL) return -1;
 
-  TAOS_RES_TYPE = enif_open_resource_type(env, mod_taos, name_res_taos, free_taos_resource, (ErlNifResourceFlags)flags, NULL);
+  TAOS_RES_TYPE = enif_open_resource_type(env, mod_taos, name_res_taos, free_taos_res, (ErlNifResourceFlags)flags, NULL);
   if(TAOS_RES_TYPE == NULL) return -1;
 
-  TAOS_ROW_TYPE = enif_open_resource_type(env, mod_taos, name_row_taos, free_taos_resource, (ErlNifResourceFlags)flags, NULL);
-  if(TAOS_ROW_TYPE == NULL) return -1;
-
-  TAOS_FIELD_TYPE = enif_open_resource_type(env, mod_taos, name_field_taos, free_taos_resource, (ErlNifResourceFlags)flags, NULL);
-  if(TAOS_FIELD_TYPE == NULL) return -1;
-
-  TAOS_STMT_TYPE = enif_open_resource_type(env, mod_taos, name_stmt_type, free_taos_resource, (ErlNifResourceFlags)flags, NULL);
+  TAOS_STMT_TYPE = enif_open_resource_type(env, mod_taos, name_stmt_type, free_taos_stmt, (ErlNifResourceFlags)flags, NULL);
   if(TAOS_STMT_TYPE == NULL) return -1;
 
+  ErlNifResourceTypeInit tmq_init = {free_tmq_resource, NULL, tmq_owner_down};
+  TMQ_TYPE = enif_open_resource_type_x(env, name_tmq_type, &tmq_init, (ErlNifResourceFlags)flags, NULL);
+  if(TMQ_TYPE == NULL) return -1;
+
   return 0;
 }
 
@@ -861,6 +1838,21 @@ static int init_nif(ErlNifEnv* env, void** priv_data, ERL_NIF_TERM load_info) {
   atom_invalid_resource = enif_make_atom(env, "invalid_resource");
   atom_excute_statement_fail = enif_make_atom(env, "exc_fail");
   atom_less_memory = enif_make_atom(env, "less_memory");
+  atom_nil = enif_make_atom(env, "nil");
+  atom_true = enif_make_atom(env, "true");
+  atom_false = enif_make_atom(env, "false");
+  atom_bad_row = enif_make_atom(env, "bad_row");
+  atom_bad_value = enif_make_atom(env, "bad_value");
+  atom_struct = enif_make_atom(env, "__struct__");
+  atom_tmq_message = enif_make_atom(env, "Elixir.Tdex.TMQ.Message");
+  atom_tdex_tmq = enif_make_atom(env, "tdex_tmq");
+  atom_consumer = enif_make_atom(env, "consumer");
+  atom_topic = enif_make_atom(env, "topic");
+  atom_database = enif_make_atom(env, "database");
+  atom_vgroup_id = enif_make_atom(env, "vgroup_id");
+  atom_offset = enif_make_atom(env, "offset");
+  atom_precision = enif_make_atom(env, "precision");
+  atom_blocks = enif_make_atom(env, "blocks");
 
   boolLen = sizeof(int8_t);
   sintLen = sizeof(int16_t);
@@ -873,26 +1865,31 @@ static int init_nif(ErlNifEnv* env, void** priv_data, ERL_NIF_TERM load_info) {
 }
 
 static ErlNifFunc nif_funcs[] = {
-  {"taos_connect", 5, taos_connect_nif},
+  {"taos_connect", 5, taos_connect_nif, ERL_NIF_DIRTY_JOB_IO_BOUND},
   {"taos_close", 1, taos_close_nif},
   {"taos_kill_query", 1, taos_kill_query_nif},
+  {"taos_stop_query", 1, taos_stop_query_nif},
   {"taos_select_db", 2, taos_select_db_nif},
-  {"taos_query", 2, taos_query_nif},
+  {"taos_query", 2, taos_query_nif, ERL_NIF_DIRTY_JOB_IO_BOUND},
   {"taos_affected_rows", 1, taos_affected_rows_nif},
   {"taos_result_precision", 1, taos_result_precision_nif},
   {"taos_free_result", 1, taos_free_result_nif},
   {"taos_fetch_fields", 1, taos_fetch_fields_nif},
   {"taos_field_count", 1, taos_field_count_nif},
-  {"taos_print_row", 3, taos_print_row_nif},
+  {"taos_print_row", 1, taos_print_row_nif},
   {"taos_cleanup", 0, taos_cleanup_nif},
-  {"taos_fetch_raw_block", 1, taos_fetch_raw_block_nif},
+  {"taos_fetch_raw_block", 1, taos_fetch_raw_block_nif, ERL_NIF_DIRTY_JOB_IO_BOUND},
   {"taos_errstr", 1, taos_errstr_nif},
   {"taos_errno", 1, taos_errno_nif},
   {"taos_fetch_row", 1, taos_fetch_row_nif},
   {"taos_query_a", 4, taos_query_a_nif},
   {"taos_stmt_init", 2, taos_stmt_init_nif},
   {"taos_stmt_bind_param_batch", 1, taos_stmt_bind_param_batch_nif},
-  {"taos_stmt_execute", 1, taos_stmt_execute_nif},
+  {"taos_stmt_bind_rows", 3, taos_stmt_bind_rows_nif, ERL_NIF_DIRTY_JOB_CPU_BOUND},
+  {"taos_stmt_bind_row", 3, taos_stmt_bind_row_nif},
+  {"taos_stmt_param_types", 1, taos_stmt_param_types_nif},
+  {"taos_stmt_use_result", 1, taos_stmt_use_result_nif},
+  {"taos_stmt_execute", 1, taos_stmt_execute_nif, ERL_NIF_DIRTY_JOB_IO_BOUND},
   {"taos_stmt_close", 1, taos_stmt_close_nif},
   {"taos_multi_bind_set_timestamp", 3, taos_multi_bind_set_timestamp_nif},
   {"taos_multi_bind_set_byte", 3, taos_multi_bind_set_byte_nif},
@@ -903,7 +1900,14 @@ static ErlNifFunc nif_funcs[] = {
   {"taos_multi_bind_set_float", 3, taos_multi_bind_set_float_nif},
   {"taos_multi_bind_set_double", 3, taos_multi_bind_set_double_nif},
   {"taos_multi_bind_set_varbinary", 3, taos_multi_bind_set_varbinary_nif},
-  {"taos_multi_bind_set_varchar", 3, taos_multi_bind_set_varchar_nif}
+  {"taos_multi_bind_set_varchar", 3, taos_multi_bind_set_varchar_nif},
+  {"taos_stats", 0, taos_stats_nif},
+  {"tmq_consumer_new", 1, tmq_consumer_new_nif, ERL_NIF_DIRTY_JOB_IO_BOUND},
+  {"tmq_subscribe", 2, tmq_subscribe_nif, ERL_NIF_DIRTY_JOB_IO_BOUND},
+  {"tmq_consumer_start", 3, tmq_consumer_start_nif},
+  {"tmq_consumer_ask", 2, tmq_consumer_ask_nif},
+  {"tmq_commit_offset", 4, tmq_commit_offset_nif, ERL_NIF_DIRTY_JOB_IO_BOUND},
+  {"tmq_consumer_close", 1, tmq_consumer_close_nif, ERL_NIF_DIRTY_JOB_IO_BOUND}
 };
 
 // static void log(format, ){
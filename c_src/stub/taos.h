@@ -0,0 +1,120 @@
+/* Subset of TDengine's taos.h used by lib_taos_nif.c, so the NIF can be
+ * built against taos_stub.c (make stub) without a TDengine client. */
+#ifndef TDEX_STUB_TAOS_H
+#define TDEX_STUB_TAOS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef void TAOS;
+typedef void TAOS_STMT;
+typedef void TAOS_RES;
+typedef void **TAOS_ROW;
+
+typedef struct tmq_t tmq_t;
+typedef struct tmq_conf_t tmq_conf_t;
+typedef struct tmq_list_t tmq_list_t;
+
+typedef enum {
+  TMQ_CONF_UNKNOWN = -2,
+  TMQ_CONF_INVALID = -1,
+  TMQ_CONF_OK = 0,
+} tmq_conf_res_t;
+
+typedef enum {
+  TSDB_OPTION_LOCALE,
+  TSDB_OPTION_CHARSET,
+  TSDB_OPTION_TIMEZONE,
+  TSDB_OPTION_CONFIGDIR,
+  TSDB_OPTION_SHELL_ACTIVITY_TIMER,
+} TSDB_OPTION;
+
+#define TSDB_DATA_TYPE_NULL 0
+#define TSDB_DATA_TYPE_BOOL 1
+#define TSDB_DATA_TYPE_TINYINT 2
+#define TSDB_DATA_TYPE_SMALLINT 3
+#define TSDB_DATA_TYPE_INT 4
+#define TSDB_DATA_TYPE_BIGINT 5
+#define TSDB_DATA_TYPE_FLOAT 6
+#define TSDB_DATA_TYPE_DOUBLE 7
+#define TSDB_DATA_TYPE_VARCHAR 8
+#define TSDB_DATA_TYPE_BINARY TSDB_DATA_TYPE_VARCHAR
+#define TSDB_DATA_TYPE_TIMESTAMP 9
+#define TSDB_DATA_TYPE_NCHAR 10
+#define TSDB_DATA_TYPE_UTINYINT 11
+#define TSDB_DATA_TYPE_USMALLINT 12
+#define TSDB_DATA_TYPE_UINT 13
+#define TSDB_DATA_TYPE_UBIGINT 14
+#define TSDB_DATA_TYPE_JSON 15
+#define TSDB_DATA_TYPE_VARBINARY 16
+
+typedef struct taosField {
+  char name[65];
+  int8_t type;
+  int32_t bytes;
+} TAOS_FIELD;
+
+typedef struct TAOS_MULTI_BIND {
+  int buffer_type;
+  void *buffer;
+  uintptr_t buffer_length;
+  int32_t *length;
+  char *is_null;
+  int num;
+} TAOS_MULTI_BIND;
+
+int taos_options(TSDB_OPTION option, const void *arg, ...);
+TAOS *taos_connect(const char *ip, const char *user, const char *pass, const char *db, uint16_t port);
+void taos_close(TAOS *taos);
+void taos_cleanup(void);
+int taos_select_db(TAOS *taos, const char *db);
+
+TAOS_RES *taos_query(TAOS *taos, const char *sql);
+void taos_query_a(TAOS *taos, const char *sql, void (*fp)(void *param, TAOS_RES *, int code), void *param);
+void taos_free_result(TAOS_RES *res);
+void taos_kill_query(TAOS *taos);
+void taos_stop_query(TAOS_RES *res);
+int taos_errno(TAOS_RES *res);
+const char *taos_errstr(TAOS_RES *res);
+int taos_field_count(TAOS_RES *res);
+int taos_affected_rows(TAOS_RES *res);
+TAOS_FIELD *taos_fetch_fields(TAOS_RES *res);
+int taos_result_precision(TAOS_RES *res);
+TAOS_ROW taos_fetch_row(TAOS_RES *res);
+int taos_print_row(char *str, TAOS_ROW row, TAOS_FIELD *fields, int num_fields);
+int taos_fetch_raw_block(TAOS_RES *res, int *numOfRows, void **pData);
+
+TAOS_STMT *taos_stmt_init(TAOS *taos);
+int taos_stmt_prepare(TAOS_STMT *stmt, const char *sql, unsigned long length);
+int taos_stmt_bind_param(TAOS_STMT *stmt, TAOS_MULTI_BIND *bind);
+int taos_stmt_bind_param_batch(TAOS_STMT *stmt, TAOS_MULTI_BIND *bind);
+int taos_stmt_add_batch(TAOS_STMT *stmt);
+int taos_stmt_is_insert(TAOS_STMT *stmt, int *insert);
+int taos_stmt_num_params(TAOS_STMT *stmt, int *nums);
+int taos_stmt_get_param(TAOS_STMT *stmt, int idx, int *type, int *bytes);
+int taos_stmt_execute(TAOS_STMT *stmt);
+TAOS_RES *taos_stmt_use_result(TAOS_STMT *stmt);
+int taos_stmt_close(TAOS_STMT *stmt);
+char *taos_stmt_errstr(TAOS_STMT *stmt);
+int taos_stmt_affected_rows(TAOS_STMT *stmt);
+
+tmq_conf_t *tmq_conf_new(void);
+tmq_conf_res_t tmq_conf_set(tmq_conf_t *conf, const char *key, const char *value);
+void tmq_conf_destroy(tmq_conf_t *conf);
+tmq_list_t *tmq_list_new(void);
+int32_t tmq_list_append(tmq_list_t *, const char *);
+void tmq_list_destroy(tmq_list_t *);
+tmq_t *tmq_consumer_new(tmq_conf_t *conf, char *errstr, int32_t errstrLen);
+int32_t tmq_subscribe(tmq_t *tmq, const tmq_list_t *topic_list);
+int32_t tmq_unsubscribe(tmq_t *tmq);
+TAOS_RES *tmq_consumer_poll(tmq_t *tmq, int64_t timeout);
+int32_t tmq_consumer_close(tmq_t *tmq);
+int32_t tmq_commit_offset_sync(tmq_t *tmq, const char *pTopicName, int32_t vgId, int64_t offset);
+const char *tmq_err2str(int32_t code);
+const char *tmq_get_topic_name(TAOS_RES *res);
+const char *tmq_get_db_name(TAOS_RES *res);
+int32_t tmq_get_vgroup_id(TAOS_RES *res);
+int64_t tmq_get_vgroup_offset(TAOS_RES *res);
+const char *tmq_get_table_name(TAOS_RES *res);
+
+#endif
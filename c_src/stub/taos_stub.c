@@ -0,0 +1,271 @@
+/* In-memory stand-in for libtaos, linked into lib_taos_nif.so by `make stub`.
+ *
+ * Every SELECT/SHOW query returns TDEX_STUB_BLOCKS (default 1) copies of one
+ * synthetic raw block of TDEX_STUB_ROWS (default 4096) rows with the schema
+ * (ts TIMESTAMP, v DOUBLE, i INT, s VARCHAR(16)); every 16th `v` is NULL.
+ * Other statements succeed with one affected row, stmt executes report the
+ * number of bound rows. Nothing leaves the process, so driver overhead can be
+ * measured without a server. With TDEX_STUB_STALL_MS set, stmt executes hang
+ * for that long, or until taos_kill_query fails them, like a stalled server. */
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <taos.h>
+
+#define STUB_COLS 4
+#define STUB_VARCHAR_LEN 16
+
+typedef struct {
+  int select;
+  int blocks_left;
+} stub_res_t;
+
+typedef struct {
+  volatile int killed;
+} stub_conn_t;
+
+typedef struct {
+  stub_conn_t* conn;
+  int rows;
+  int affected;
+  int params;
+  stub_res_t res;
+} stub_stmt_t;
+
+static TAOS_FIELD stub_fields[STUB_COLS] = {
+  {"ts", TSDB_DATA_TYPE_TIMESTAMP, 8},
+  {"v", TSDB_DATA_TYPE_DOUBLE, 8},
+  {"i", TSDB_DATA_TYPE_INT, 4},
+  {"s", TSDB_DATA_TYPE_VARCHAR, STUB_VARCHAR_LEN + 2}
+};
+
+static char* stub_block = NULL;
+static int stub_rows = 0;
+static int stub_blocks = 1;
+static char stub_name[] = "stub";
+static pthread_once_t stub_once = PTHREAD_ONCE_INIT;
+
+static int env_int(const char* name, int def) {
+  const char* v = getenv(name);
+  if(v == NULL || atoi(v) <= 0) return def;
+  return atoi(v);
+}
+
+static char* put32(char* p, int32_t v) {
+  memcpy(p, &v, 4);
+  return p + 4;
+}
+
+static void stub_build_block_once(void) {
+  stub_rows = env_int("TDEX_STUB_ROWS", 4096);
+  stub_blocks = env_int("TDEX_STUB_BLOCKS", 1);
+
+  int rows = stub_rows;
+  int bitmap = (rows + 7) / 8;
+  char str[STUB_VARCHAR_LEN + 1];
+  int str_len = snprintf(str, sizeof(str), "stub-%06d", 0);
+  int32_t lengths[STUB_COLS] = {rows * 8, rows * 8, rows * 4, rows * (2 + str_len)};
+  int size = 28 + STUB_COLS * 5 + STUB_COLS * 4
+    + 3 * (bitmap) + lengths[0] + lengths[1] + lengths[2]
+    + rows * 4 + lengths[3];
+
+  char* block = (char*)calloc(1, size);
+  char* p = block;
+  p = put32(p, 1);
+  p = put32(p, size);
+  p = put32(p, rows);
+  p = put32(p, STUB_COLS);
+  p += 4 + 8;
+  for(int c = 0; c < STUB_COLS; c++){
+    *p++ = stub_fields[c].type;
+    p = put32(p, stub_fields[c].bytes);
+  }
+  for(int c = 0; c < STUB_COLS; c++) p = put32(p, lengths[c]);
+
+  /* ts */
+  p += bitmap;
+  for(int r = 0; r < rows; r++){
+    int64_t ts = 1700000000000LL + r;
+    memcpy(p, &ts, 8);
+    p += 8;
+  }
+  /* v, NULL every 16th row */
+  for(int r = 0; r < rows; r += 16) p[r >> 3] |= (char)(1 << (7 - (r & 7)));
+  p += bitmap;
+  for(int r = 0; r < rows; r++){
+    double v = r * 0.5;
+    memcpy(p, &v, 8);
+    p += 8;
+  }
+  /* i */
+  p += bitmap;
+  for(int r = 0; r < rows; r++) p = put32(p, r);
+  /* s */
+  for(int r = 0; r < rows; r++) p = put32(p, r * (2 + str_len));
+  for(int r = 0; r < rows; r++){
+    int16_t len = (int16_t)str_len;
+    snprintf(str, sizeof(str), "stub-%06d", r % 1000000);
+    memcpy(p, &len, 2);
+    memcpy(p + 2, str, str_len);
+    p += 2 + str_len;
+  }
+  stub_block = block;
+}
+
+static void stub_build_block(void) {
+  pthread_once(&stub_once, stub_build_block_once);
+}
+
+static void stub_res_init(stub_res_t* res, int select) {
+  stub_build_block();
+  res->select = select;
+  res->blocks_left = select ? stub_blocks : 0;
+}
+
+static int is_select(const char* sql) {
+  while(*sql && isspace((unsigned char)*sql)) sql++;
+  return strncasecmp(sql, "select", 6) == 0 || strncasecmp(sql, "show", 4) == 0;
+}
+
+int taos_options(TSDB_OPTION option, const void* arg, ...) { return 0; }
+
+TAOS* taos_connect(const char* ip, const char* user, const char* pass, const char* db, uint16_t port) {
+  stub_build_block();
+  return calloc(1, sizeof(stub_conn_t));
+}
+
+void taos_close(TAOS* taos) { free(taos); }
+void taos_cleanup(void) {}
+int taos_select_db(TAOS* taos, const char* db) { return 0; }
+
+TAOS_RES* taos_query(TAOS* taos, const char* sql) {
+  stub_res_t* res = (stub_res_t*)malloc(sizeof(stub_res_t));
+  stub_res_init(res, is_select(sql));
+  return res;
+}
+
+void taos_query_a(TAOS* taos, const char* sql, void (*fp)(void* param, TAOS_RES*, int code), void* param) {
+  TAOS_RES* res = taos_query(taos, sql);
+  if(fp) fp(param, res, 0);
+  else taos_free_result(res);
+}
+
+void taos_free_result(TAOS_RES* res) { free(res); }
+void taos_kill_query(TAOS* taos) {
+  __atomic_store_n(&((stub_conn_t*)taos)->killed, 1, __ATOMIC_SEQ_CST);
+}
+void taos_stop_query(TAOS_RES* res) { ((stub_res_t*)res)->blocks_left = 0; }
+int taos_errno(TAOS_RES* res) { return 0; }
+const char* taos_errstr(TAOS_RES* res) { return ""; }
+int taos_field_count(TAOS_RES* res) { return ((stub_res_t*)res)->select ? STUB_COLS : 0; }
+int taos_affected_rows(TAOS_RES* res) { return ((stub_res_t*)res)->select ? 0 : 1; }
+TAOS_FIELD* taos_fetch_fields(TAOS_RES* res) { return stub_fields; }
+int taos_result_precision(TAOS_RES* res) { return 0; }
+TAOS_ROW taos_fetch_row(TAOS_RES* res) { return NULL; }
+int taos_print_row(char* str, TAOS_ROW row, TAOS_FIELD* fields, int num_fields) { str[0] = 0; return 0; }
+
+int taos_fetch_raw_block(TAOS_RES* res, int* numOfRows, void** pData) {
+  stub_res_t* r = (stub_res_t*)res;
+  *pData = stub_block;
+  if(r->blocks_left > 0){
+    r->blocks_left--;
+    *numOfRows = stub_rows;
+  } else {
+    *numOfRows = 0;
+  }
+  return 0;
+}
+
+TAOS_STMT* taos_stmt_init(TAOS* taos) {
+  stub_stmt_t* s = (stub_stmt_t*)calloc(1, sizeof(stub_stmt_t));
+  if(s) s->conn = (stub_conn_t*)taos;
+  return s;
+}
+
+int taos_stmt_prepare(TAOS_STMT* stmt, const char* sql, unsigned long length) {
+  stub_stmt_t* s = (stub_stmt_t*)stmt;
+  stub_res_init(&s->res, is_select(sql));
+  for(s->params = 0; *sql; sql++) if(*sql == '?') s->params++;
+  return 0;
+}
+
+int taos_stmt_is_insert(TAOS_STMT* stmt, int* insert) {
+  *insert = !((stub_stmt_t*)stmt)->res.select;
+  return 0;
+}
+
+int taos_stmt_num_params(TAOS_STMT* stmt, int* nums) {
+  *nums = ((stub_stmt_t*)stmt)->params;
+  return 0;
+}
+
+/* inserts take the stub schema's column types in order */
+int taos_stmt_get_param(TAOS_STMT* stmt, int idx, int* type, int* bytes) {
+  TAOS_FIELD* f = &stub_fields[idx % STUB_COLS];
+  *type = f->type;
+  *bytes = f->bytes;
+  return 0;
+}
+
+int taos_stmt_bind_param(TAOS_STMT* stmt, TAOS_MULTI_BIND* bind) {
+  ((stub_stmt_t*)stmt)->rows += bind ? bind->num : 1;
+  return 0;
+}
+
+int taos_stmt_bind_param_batch(TAOS_STMT* stmt, TAOS_MULTI_BIND* bind) {
+  return taos_stmt_bind_param(stmt, bind);
+}
+
+int taos_stmt_add_batch(TAOS_STMT* stmt) { return 0; }
+
+int taos_stmt_execute(TAOS_STMT* stmt) {
+  stub_stmt_t* s = (stub_stmt_t*)stmt;
+  int stall = env_int("TDEX_STUB_STALL_MS", 0);
+  __atomic_store_n(&s->conn->killed, 0, __ATOMIC_SEQ_CST);
+  for(int ms = 0; ms < stall; ms++){
+    if(__atomic_load_n(&s->conn->killed, __ATOMIC_SEQ_CST)){
+      s->rows = 0;
+      return -1;
+    }
+    usleep(1000);
+  }
+  s->affected = s->res.select ? 0 : s->rows;
+  s->rows = 0;
+  stub_res_init(&s->res, s->res.select);
+  return 0;
+}
+
+TAOS_RES* taos_stmt_use_result(TAOS_STMT* stmt) { return &((stub_stmt_t*)stmt)->res; }
+int taos_stmt_close(TAOS_STMT* stmt) { free(stmt); return 0; }
+char* taos_stmt_errstr(TAOS_STMT* stmt) {
+  return __atomic_load_n(&((stub_stmt_t*)stmt)->conn->killed, __ATOMIC_SEQ_CST) ? "killed" : "";
+}
+int taos_stmt_affected_rows(TAOS_STMT* stmt) { return ((stub_stmt_t*)stmt)->affected; }
+
+tmq_conf_t* tmq_conf_new(void) { return malloc(1); }
+tmq_conf_res_t tmq_conf_set(tmq_conf_t* conf, const char* key, const char* value) { return TMQ_CONF_OK; }
+void tmq_conf_destroy(tmq_conf_t* conf) { free(conf); }
+tmq_list_t* tmq_list_new(void) { return malloc(1); }
+int32_t tmq_list_append(tmq_list_t* list, const char* topic) { return 0; }
+void tmq_list_destroy(tmq_list_t* list) { free(list); }
+tmq_t* tmq_consumer_new(tmq_conf_t* conf, char* errstr, int32_t errstrLen) { return malloc(1); }
+int32_t tmq_subscribe(tmq_t* tmq, const tmq_list_t* topic_list) { return 0; }
+int32_t tmq_unsubscribe(tmq_t* tmq) { return 0; }
+
+TAOS_RES* tmq_consumer_poll(tmq_t* tmq, int64_t timeout) {
+  if(timeout > 0) usleep(timeout * 1000);
+  return NULL;
+}
+
+int32_t tmq_consumer_close(tmq_t* tmq) { free(tmq); return 0; }
+int32_t tmq_commit_offset_sync(tmq_t* tmq, const char* pTopicName, int32_t vgId, int64_t offset) { return 0; }
+const char* tmq_err2str(int32_t code) { return ""; }
+const char* tmq_get_topic_name(TAOS_RES* res) { return stub_name; }
+const char* tmq_get_db_name(TAOS_RES* res) { return stub_name; }
+int32_t tmq_get_vgroup_id(TAOS_RES* res) { return 0; }
+int64_t tmq_get_vgroup_offset(TAOS_RES* res) { return 0; }
+const char* tmq_get_table_name(TAOS_RES* res) { return stub_name; }
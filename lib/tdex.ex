@@ -5,18 +5,33 @@ defmodule Tdex do
 
   def start(_type, _args) do
     Tdex.Ets.create_table()
+    Tdex.Cache.create_table()
     :logger.add_handlers(:tdex)
     Supervisor.start_link([], strategy: :one_for_one)
   end
 
   def start_link() do
-    opts = Application.get_env(:tdex, Tdex.Repo) |> default_opts()
-    DBConnection.start_link(Tdex.DBConnection, opts)
+    Application.get_env(:tdex, Tdex.Repo) |> start_link()
   end
 
   def start_link(opts) do
     opts = default_opts(opts)
-    DBConnection.start_link(Tdex.DBConnection, opts)
+    case start_pool(opts) do
+      {:ok, pid} ->
+        Tdex.Endpoints.watch(opts[:endpoints], pid)
+        if opts[:cache], do: Tdex.Cache.warm(pid, opts[:cache])
+        {:ok, pid}
+      error ->
+        Tdex.Endpoints.delete(opts[:endpoints])
+        error
+    end
+  end
+
+  defp start_pool(opts) do
+    case opts[:pool_mode] do
+      :partitioned -> Tdex.Partitioned.start_link(opts)
+      _ -> DBConnection.start_link(Tdex.DBConnection, opts)
+    end
   end
 
   def query(conn, statement, params, opts \\ [])
@@ -24,7 +39,7 @@ defmodule Tdex do
     query(conn, %Query{name: "", statement: statement}, params, opts)
   end
   def query(conn, query, params, opts) do
-    case DBConnection.prepare_execute(conn, query, params, opts) do
+    case Tdex.Partitioned.run(conn, &DBConnection.prepare_execute(&1, query, params, call_opts(opts))) do
       {:ok, query, result} -> {:ok, query, result}
       {:error, _} = error -> error
     end
@@ -35,17 +50,44 @@ defmodule Tdex do
     query!(conn, %Query{name: "", statement: statement}, params, opts)
   end
   def query!(conn, query, params, opts) do
-    case DBConnection.prepare_execute(conn, query, params, opts) do
+    case Tdex.Partitioned.run(conn, &DBConnection.prepare_execute(&1, query, params, call_opts(opts))) do
       {:ok, _, result} -> result
       {:error, error} -> raise error
     end
   end
 
   def execute(conn, query, params, opts \\ []) do
-    DBConnection.execute(conn, query, params, opts)
+    Tdex.Partitioned.run(conn, &DBConnection.execute(&1, query, params, call_opts(opts)))
   end
 
   def execute!(conn, query, params, opts \\ []) do
-    DBConnection.execute!(conn, query, params, opts)
+    Tdex.Partitioned.run(conn, &DBConnection.execute!(&1, query, params, call_opts(opts)))
+  end
+
+  @doc """
+  Loads `stream` into `table` through the stmt API, `batch_rows` rows (default 10_000) per batch.
+
+  Stream elements are CSV chunks (binaries, split on newlines anywhere; `header: true` skips the
+  first line), or rows as maps keyed like `schema`, lists or tuples in column order. `schema` has
+  the `%{col: {type, index}}` form of `%Tdex.Query{schema: ...}`, plus `:nchar`. Values are parsed
+  and converted natively, timestamps are integers in the database precision. Memory is bounded by
+  two batches; returns `{:ok, %{rows, batches, affected_rows, duration_ms, rows_per_sec}}`.
+  """
+  def bulk_load(conn, stream, table, schema, opts \\ []) do
+    {bulk_opts, opts} = Keyword.split(opts, [:batch_rows, :header])
+    query = %Query{name: "bulk_load", statement: table, schema: schema}
+    opts = opts |> Keyword.put_new(:timeout, :infinity) |> call_opts()
+    case Tdex.Partitioned.run(conn, &DBConnection.execute(&1, query, {:bulk_load, stream, bulk_opts}, opts)) do
+      {:ok, _query, stats} -> {:ok, stats}
+      {:error, _} = error -> error
+    end
+  end
+
+  # `timeout:`/`deadline:` become a deadline for the native cancel, DBConnection's own
+  # timeout is pushed past it (see `Tdex.Deadline`).
+  defp call_opts(opts) do
+    opts
+    |> Tdex.Deadline.put_opts()
+    |> Keyword.put_new(:log, &Tdex.Telemetry.log/1)
   end
 end
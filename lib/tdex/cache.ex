@@ -0,0 +1,140 @@
+defmodule Tdex.Cache do
+  @moduledoc """
+  Write-through latest-row cache, one entry per subtable.
+
+  Enabled per pool with `cache: [name: :meters, max_tables: 100_000, precision: :millisecond, warm: sql]`.
+  Rows written through the stmt insert path (`%Tdex.Query{schema: ...}`) replace the cached row of
+  their table when their `ts` is not older. `warm` is run once at start and must return a `tbname`
+  column; `LAST_ROW(col)` column names are stored as `col`. Cached `ts` values are integers in the
+  configured precision, the same unit the stmt path binds.
+
+  The cache is opt-in on the read side: only `last_row/2` and `last_rows/1` read it, while
+  `SELECT LAST_ROW(...)` sent through `Tdex.query/4` still goes to the server. It only sees rows
+  written through this pool, so it cannot stand in for the server when other writers exist.
+  """
+  require Logger
+  @name_table :tdex_cache
+  @insert_re ~r/^\s*insert\s+into\s+([^\s(]+)/i
+  @last_row_re ~r/^last_row\((.+)\)$/i
+
+  def create_table() do
+    case :ets.info(@name_table) do
+      :undefined ->
+        :ets.new(@name_table,
+          [:public, :named_table, :set, {:read_concurrency, true}, {:write_concurrency, true}])
+      _ ->
+        :ok
+    end
+  end
+
+  def new(nil), do: nil
+  def new(false), do: nil
+  def new(true), do: new([])
+  def new(opts) do
+    %{
+      name: Keyword.get(opts, :name, :default),
+      max_tables: Keyword.get(opts, :max_tables, 100_000),
+      precision: Keyword.get(opts, :precision, :millisecond),
+      warm: Keyword.get(opts, :warm)
+    }
+  end
+
+  def last_row(name, table) do
+    case :ets.lookup(@name_table, {name, to_string(table)}) do
+      [{_, _ts, row}] -> row
+      [] -> nil
+    end
+  end
+
+  def last_rows(name) do
+    :ets.select(@name_table, [{{{name, :"$1"}, :_, :"$2"}, [], [{{:"$1", :"$2"}}]}])
+  end
+
+  def size(name) do
+    case :ets.lookup(:tdex, {:cache_size, name}) do
+      [{_, size}] -> size
+      [] -> 0
+    end
+  end
+
+  def clear(name) do
+    :ets.match_delete(@name_table, {{name, :_}, :_, :_})
+    :ets.delete(:tdex, {:cache_size, name})
+    :ok
+  end
+
+  def put_rows(nil, _statement, _rows, _schema), do: :ok
+  def put_rows(cache, statement, rows, schema) do
+    with [_, table] <- Regex.run(@insert_re, to_string(statement)),
+         table when table != "?" <- table_name(table),
+         {ts_key, {:ts, _}} <- Enum.find(schema, fn {_, v} -> match?({:ts, _}, v) end)
+    do
+      rows
+      |> Enum.reduce(nil, fn
+        %{^ts_key => ts} = row, nil -> {ts, row}
+        %{^ts_key => ts} = row, {max_ts, _} when ts >= max_ts -> {ts, row}
+        _, acc -> acc
+      end)
+      |> case do
+        nil -> :ok
+        {ts, row} -> put(cache, table, ts, row)
+      end
+    else
+      _ -> :ok
+    end
+  end
+
+  def put(%{name: name, max_tables: max_tables}, table, ts, row) do
+    key = {name, table}
+    spec = [{{key, :"$1", :_}, [{:"=<", :"$1", ts}], [{{{:const, key}, ts, {:const, row}}}]}]
+    with 0 <- :ets.select_replace(@name_table, spec),
+         false <- :ets.member(@name_table, key),
+         true <- size(name) < max_tables,
+         true <- :ets.insert_new(@name_table, {key, ts, row})
+    do
+      :ets.update_counter(:tdex, {:cache_size, name}, {2, 1}, {{:cache_size, name}, 0})
+      :ok
+    else
+      _ -> :ok
+    end
+  end
+
+  def warm(_conn, %{warm: nil}), do: :ok
+  def warm(conn, %{warm: sql} = cache) do
+    case Tdex.query(conn, sql, []) do
+      {:ok, _, %Tdex.Result{rows: rows}} ->
+        put_warm_rows(cache, rows)
+      {:error, err} ->
+        Logger.error("warm cache #{inspect(cache.name)} failed: #{inspect(err)}")
+        {:error, err}
+    end
+  end
+
+  @doc false
+  def put_warm_rows(%{precision: precision} = cache, rows) do
+    Enum.each(rows, fn row ->
+      row = Map.new(row, fn {k, v} -> {column_name(k), v} end)
+      case Map.pop(row, :tbname) do
+        {nil, _} -> :ok
+        {table, row} ->
+          ts = to_unix(row[:ts], precision)
+          put(cache, table, ts, Map.put(row, :ts, ts))
+      end
+    end)
+  end
+
+  defp table_name(table) do
+    table |> String.split(".") |> List.last() |> String.trim("`")
+  end
+
+  @doc false
+  def column_name(key) do
+    case Regex.run(@last_row_re, Atom.to_string(key)) do
+      [_, col] -> String.to_atom(col)
+      nil -> key
+    end
+  end
+
+  defp to_unix(ts, precision) when is_struct(ts, Timestamp) or is_struct(ts, DateTime), do: Timestamp.to_unix(ts, precision)
+  defp to_unix(ts, _precision), do: ts
+end
@@ -1,18 +1,38 @@
 defmodule Tdex.DBConnection do
   use DBConnection
-  alias Tdex.Common
+  alias Tdex.{Common, Deadline, Endpoints, Telemetry}
   require Logger
   require Skn.Log
 
   @impl true
   def connect(opts) do
     opts = Map.new(opts)
-    case opts.protocol.connect(opts) do
+    case opts[:endpoints] do
+      nil -> connect_endpoint(opts)
+      endpoints -> connect_any(Endpoints.candidates(endpoints), opts, nil)
+    end
+  end
+
+  defp connect_endpoint(opts) do
+    meta = %{protocol: opts.protocol, hostname: opts.hostname, port: opts.port}
+    case Telemetry.span([:connect], meta, fn -> opts.protocol.connect(opts) end) do
       {:ok, pid} -> {:ok, %{opts | conn: pid}}
       {:error, _} = error -> error
     end
   end
 
+  defp connect_any([], _opts, error), do: error
+  defp connect_any([{idx, host, port} | rest], opts, _error) do
+    case connect_endpoint(%{opts | hostname: host, port: port}) do
+      {:ok, state} ->
+        Endpoints.up(opts.endpoints, idx)
+        {:ok, Map.put(state, :endpoint, idx)}
+      {:error, _} = error ->
+        Endpoints.down(opts.endpoints, idx)
+        connect_any(rest, opts, error)
+    end
+  end
+
   @impl true
   def checkout(state) do
     {:ok, state}
@@ -44,6 +64,17 @@ defmodule Tdex.DBConnection do
   end
 
   @impl true
+  def ping(%{endpoints: endpoints, endpoint: idx} = state) do
+    case timed(state, fn -> state.protocol.query(state.conn, "SELECT SERVER_STATUS()") end) do
+      {:ok, _} -> {:ok, state}
+      {:error, error} ->
+        Endpoints.down(endpoints, idx)
+        {:disconnect, error, state}
+    end
+  catch _, ex ->
+    Endpoints.down(endpoints, idx)
+    {:disconnect, ex, state}
+  end
   def ping(state) do
     {:ok, state}
   end
@@ -65,39 +96,50 @@ defmodule Tdex.DBConnection do
   end
 
   @impl true
-  def handle_execute(query, params, _, %{conn: conn, protocol: protocol} = state) do
+  def handle_execute(%{schema: sche, statement: table} = query, {:bulk_load, stream, opts}, _, %{conn: conn, protocol: protocol} = state) do
+    case protocol.bulk_load(conn, table, sche, stream, opts) do
+      {:ok, stats} -> {:ok, query, stats, state}
+      {:error, error} -> {:error, error, state}
+    end
+  catch _, ex ->
+    {:error, ex, state}
+  end
+  def handle_execute(query, params, opts, %{conn: conn, protocol: protocol} = state) do
     case query do
       %{schema: nil, statement: sql} ->
-        with {:ok, query_params} <- Common.interpolate_params(sql, params),
-          {:ok, result} <- protocol.query(conn, query_params)
-        do
-          {:ok, %Tdex.Query{name: "", statement: query_params}, result, state}
-        else
-          {:error, error} -> {:error, error, state}
+        deadline = Deadline.from_opts(opts)
+        case bind_params(sql, params, opts, state) do
+          {:fallback, state} ->
+            with {:ok, query_params} <- Common.interpolate_params(sql, params),
+              {:ok, result} <- timed(state, fn -> protocol.query(conn, query_params, deadline) end)
+            do
+              {:ok, %Tdex.Query{name: "", statement: query_params}, result, state}
+            else
+              {:error, error} -> {:error, error, state}
+            end
+          {{:ok, result}, state} -> {:ok, query, result, state}
+          {{:error, error}, state} -> {:error, error, state}
         end
       %{schema: sche, statement: sql} ->
-        {:ok, stmt} = protocol.statement_init(conn, sql)
+        {:ok, stmt} = Telemetry.span([:stmt, :init], %{protocol: protocol}, fn -> protocol.statement_init(conn, sql) end)
         try do
-          Enum.each(params, fn row ->
-            Enum.each(row, fn {k, v} ->
-              case sche[k] do
-                {:ts, idx} -> :ok = protocol.bind_set_timestamp(stmt, idx, v)
-                {:bool, idx} -> :ok = protocol.bind_set_bool(stmt, idx, v)
-                {:int32, idx} -> :ok = protocol.bind_set_int32(stmt, idx, v)
-                {:int16, idx} -> :ok = protocol.bind_set_int16(stmt, idx, v)
-                {:int8, idx} -> :ok = protocol.bind_set_int8(stmt, idx, v)
-                {:int64, idx} -> :ok = protocol.bind_set_int64(stmt, idx, v)
-                {:float, idx} -> :ok = protocol.bind_set_float(stmt, idx, v)
-                {:double, idx} -> :ok = protocol.bind_set_double(stmt, idx, v)
-                {:varbinary, idx} -> :ok = protocol.bind_set_varbinary(stmt, idx, v)
-                {:varchar, idx} -> :ok = protocol.bind_set_varchar(stmt, idx, v)
-                nil -> :ok
-              end
-            end)
-            :ok = protocol.bind_param(stmt)
-          end)
-          result = protocol.execute_statement(stmt)
-          {:ok, query, result, state}
+          Telemetry.span([:stmt, :bind], %{protocol: protocol, rows: length(params)}, fn -> bind_rows(protocol, stmt, sche, params) end)
+          deadline = Deadline.from_opts(opts)
+          # no result handle to stop yet; the kill only reaches this execute, the connection is checked out
+          watchdog = Deadline.watch(deadline, fn -> protocol.stop_query(conn) end)
+          result =
+            try do
+              Telemetry.span([:stmt, :execute], %{protocol: protocol}, fn -> protocol.execute_statement(stmt) end)
+            after
+              Deadline.done(watchdog)
+            end
+          case result do
+            {:ok, _} ->
+              Tdex.Cache.put_rows(state[:cache], sql, params, sche)
+              {:ok, query, result, state}
+            failed ->
+              {:error, stmt_error(failed, deadline), state}
+          end
         catch _, ex ->
           {:error, ex, state}
         after
@@ -108,6 +150,87 @@ defmodule Tdex.DBConnection do
     {:error, ex, state}
   end
 
+  # A stmt execute cancelled by its deadline watchdog fails like any other, the clock tells them apart.
+  defp stmt_error(failed, deadline) do
+    cond do
+      Deadline.expired?(deadline) -> Deadline.error()
+      match?({:exc_fail, _, _}, failed) -> %Tdex.Error{code: elem(failed, 1), message: elem(failed, 2)}
+      true -> %Tdex.Error{message: inspect(failed)}
+    end
+  end
+
+  # `bind_params: true` (pool or per query) prepares `?` statements server side,
+  # statements are cached per connection in `state.stmts`.
+  defp bind_params(_sql, [], _opts, state), do: {:fallback, state}
+  defp bind_params(sql, params, opts, %{conn: conn, protocol: protocol} = state) do
+    if Keyword.get(opts, :bind_params, state[:bind_params]) do
+      state = with_precision(state)
+      {result, stmts} = timed(state, fn ->
+        protocol.prepared_query(conn, Map.get(state, :stmts, %{}), sql, params, state.db_precision, Deadline.from_opts(opts))
+      end)
+      {result, Map.put(state, :stmts, stmts)}
+    else
+      {:fallback, state}
+    end
+  end
+
+  # Timestamps are bound in the precision of the connection's database, read on the
+  # first bind; nil (timestamps interpolated) when it cannot be read or `precision:`
+  # was set to something else.
+  defp with_precision(%{db_precision: _} = state), do: state
+  defp with_precision(%{conn: conn, protocol: protocol} = state) do
+    sql = "SELECT `precision` FROM information_schema.ins_databases WHERE name = '#{state[:database]}'"
+    precision =
+      case protocol.query(conn, sql) do
+        {:ok, %Tdex.Result{rows: [%{precision: unit}]}} -> precision_unit(unit)
+        _ -> nil
+      end
+    precision =
+      if state[:precision] && state[:precision] != precision do
+        Logger.warning("tdex: precision: #{inspect(state[:precision])} does not match database #{state[:database]} (#{inspect(precision)}), timestamps are interpolated")
+        nil
+      else
+        precision
+      end
+    Map.put(state, :db_precision, precision)
+  catch _, _ ->
+    Map.put(state, :db_precision, nil)
+  end
+
+  defp precision_unit("ms"), do: :millisecond
+  defp precision_unit("us"), do: :microsecond
+  defp precision_unit("ns"), do: :nanosecond
+  defp precision_unit(_), do: nil
+
+  defp timed(%{endpoints: endpoints, endpoint: idx}, fun) do
+    t0 = System.monotonic_time()
+    result = fun.()
+    Endpoints.report(endpoints, idx, System.convert_time_unit(System.monotonic_time() - t0, :native, :microsecond))
+    result
+  end
+  defp timed(_state, fun), do: fun.()
+
+  defp bind_rows(protocol, stmt, sche, params) do
+    Enum.each(params, fn row ->
+      Enum.each(row, fn {k, v} ->
+        case sche[k] do
+          {:ts, idx} -> :ok = protocol.bind_set_timestamp(stmt, idx, v)
+          {:bool, idx} -> :ok = protocol.bind_set_bool(stmt, idx, v)
+          {:int32, idx} -> :ok = protocol.bind_set_int32(stmt, idx, v)
+          {:int16, idx} -> :ok = protocol.bind_set_int16(stmt, idx, v)
+          {:int8, idx} -> :ok = protocol.bind_set_int8(stmt, idx, v)
+          {:int64, idx} -> :ok = protocol.bind_set_int64(stmt, idx, v)
+          {:float, idx} -> :ok = protocol.bind_set_float(stmt, idx, v)
+          {:double, idx} -> :ok = protocol.bind_set_double(stmt, idx, v)
+          {:varbinary, idx} -> :ok = protocol.bind_set_varbinary(stmt, idx, v)
+          {:varchar, idx} -> :ok = protocol.bind_set_varchar(stmt, idx, v)
+          nil -> :ok
+        end
+      end)
+      :ok = protocol.bind_param(stmt)
+    end)
+  end
+
   @impl true
   def handle_deallocate(_query, _cursor, _opts, state) do
     {:ok, nil, state}
@@ -0,0 +1,88 @@
+defmodule Tdex.Deadline do
+  @moduledoc """
+  Per-query deadlines. `Tdex.query/4` and friends accept `deadline:` (an absolute
+  `System.monotonic_time(:millisecond)`) or `timeout:` (ms from the call, pool wait included).
+  When it passes, only that query is cancelled: `taos_kill_query` while `taos_query` or a stmt execute is still
+  running, `taos_stop_query` on its result afterwards, or `free_result` on ws. The call returns
+  `{:error, %Tdex.Error{code: :deadline}}` and the connection stays in the pool.
+  """
+  # DBConnection disconnects a connection held past its own `timeout`, which is
+  # pushed this far past the deadline so the native cancel gets there first.
+  @grace 5_000
+
+  def put_opts(opts) do
+    case deadline(opts) do
+      :infinity -> opts
+      deadline -> Keyword.merge(opts, deadline: deadline, timeout: remaining(deadline) + @grace)
+    end
+  end
+
+  defp deadline(opts) do
+    cond do
+      opts[:deadline] -> opts[:deadline]
+      is_integer(opts[:timeout]) -> now() + opts[:timeout]
+      true -> :infinity
+    end
+  end
+
+  def from_opts(opts), do: Keyword.get(opts, :deadline, :infinity)
+
+  def remaining(:infinity), do: :infinity
+  def remaining(deadline), do: max(deadline - now(), 0)
+
+  @doc "Receive timeout for one step: the remaining time, capped by `timeout`."
+  def timeout(:infinity, timeout), do: timeout
+  def timeout(deadline, timeout), do: min(remaining(deadline), timeout)
+
+  def expired?(:infinity), do: false
+  def expired?(deadline), do: now() >= deadline
+
+  def error(), do: %Tdex.Error{code: :deadline, message: "query cancelled, deadline exceeded"}
+
+  @doc """
+  Runs `cancel` if the deadline passes before `done/1`. `update/2` swaps the
+  cancel function once the query has a result handle.
+  """
+  def watch(:infinity, _cancel), do: nil
+  def watch(deadline, cancel) do
+    owner = self()
+    spawn(fn ->
+      ref = Process.monitor(owner)
+      wait(deadline, cancel, ref)
+    end)
+  end
+
+  def update(nil, _cancel), do: :ok
+  def update(watchdog, cancel) do
+    send(watchdog, {:cancel, cancel})
+    :ok
+  end
+
+  # Synchronous, so a cancel never lands after the connection went back to the pool.
+  def done(nil), do: :ok
+  def done(watchdog) do
+    ref = Process.monitor(watchdog)
+    send(watchdog, {:done, self(), ref})
+    receive do
+      {:done, ^ref} -> Process.demonitor(ref, [:flush])
+      {:DOWN, ^ref, _, _, _} -> :ok
+    end
+    :ok
+  end
+
+  defp wait(deadline, cancel, ref) do
+    receive do
+      {:cancel, cancel} -> wait(deadline, cancel, ref)
+      {:done, from, done_ref} -> send(from, {:done, done_ref})
+      {:DOWN, ^ref, _, _, _} -> :ok
+    after remaining(deadline) ->
+      cancel.()
+      receive do
+        {:done, from, done_ref} -> send(from, {:done, done_ref})
+        {:DOWN, ^ref, _, _, _} -> :ok
+      end
+    end
+  end
+
+  defp now(), do: System.monotonic_time(:millisecond)
+end
@@ -0,0 +1,109 @@
+defmodule Tdex.Endpoints do
+  @moduledoc """
+  Endpoint selection for pools spread over several dnodes/frontends.
+
+  Enabled with `endpoints: ["td1:6030", {"td2", 6030}, "td3"]` (a missing port uses `:port`).
+  New pool connections go to the next endpoint in `balance: :round_robin` order (default) or,
+  with `balance: :least_latency`, to the endpoint with the lowest moving average query latency.
+  An endpoint whose connect or health check fails is skipped for `down_interval` ms (default
+  5000) and the connection moves on to the next one. Health checks are DBConnection pings on
+  idle connections, every `idle_interval` ms.
+
+  Balancing only happens when a connection (re)connects: an established connection stays on
+  its endpoint until it fails, even when another endpoint has become faster. Endpoint state
+  lives in the `:tdex` ETS table and is deleted when the pool stops.
+  """
+  @name_table :tdex
+  @alpha 0.2
+
+  def new(nil, _opts), do: nil
+  def new([], _opts), do: nil
+  def new(endpoints, opts) do
+    group = make_ref()
+    endpoints
+    |> Enum.map(&parse(&1, Keyword.get(opts, :port)))
+    |> Enum.with_index()
+    |> Enum.each(fn {{host, port}, idx} ->
+      :ets.insert(@name_table, {{:endpoint, group, idx}, host, port, 0, 0})
+    end)
+    %{
+      group: group,
+      count: length(endpoints),
+      balance: Keyword.get(opts, :balance, :round_robin),
+      down_interval: Keyword.get(opts, :down_interval, 5000)
+    }
+  end
+
+  @doc "Deletes the group's endpoint rows once `pool` exits."
+  def watch(nil, _pool), do: :ok
+  def watch(endpoints, pool) do
+    spawn(fn ->
+      ref = Process.monitor(pool)
+      receive do
+        {:DOWN, ^ref, _, _, _} -> delete(endpoints)
+      end
+    end)
+    :ok
+  end
+
+  def delete(nil), do: :ok
+  def delete(%{group: group}) do
+    :ets.match_delete(@name_table, {{:endpoint, group, :_}, :_, :_, :_, :_})
+    :ets.delete(@name_table, {:endpoint_rr, group})
+    :ok
+  end
+
+  defp parse({host, port}, _default_port), do: {to_string(host), port}
+  defp parse(endpoint, default_port) do
+    case String.split(endpoint, ":") do
+      [host, port] -> {host, String.to_integer(port)}
+      [host] -> {host, default_port}
+    end
+  end
+
+  @doc "Endpoints to try for a new connection, best first; endpoints marked down come last."
+  def candidates(%{group: group, count: count, balance: balance}) do
+    now = now()
+    start = :ets.update_counter(@name_table, {:endpoint_rr, group}, {2, 1}, {{:endpoint_rr, group}, -1})
+    {up, down} =
+      Enum.map(0..(count - 1), fn i ->
+        idx = rem(start + i, count)
+        [{_, host, port, latency, down_until}] = :ets.lookup(@name_table, {:endpoint, group, idx})
+        {idx, host, port, latency, down_until}
+      end)
+      |> Enum.split_with(fn {_, _, _, _, down_until} -> down_until <= now end)
+    up = if balance == :least_latency, do: Enum.sort_by(up, &elem(&1, 3)), else: up
+    Enum.map(up ++ Enum.sort_by(down, &elem(&1, 4)), fn {idx, host, port, _, _} -> {idx, host, port} end)
+  end
+
+  @doc "Folds one query latency (microseconds) into the endpoint's moving average."
+  def report(%{group: group}, idx, latency) do
+    key = {:endpoint, group, idx}
+    latency = max(latency, 1)
+    case :ets.lookup(@name_table, key) do
+      [{_, _, _, 0, _}] -> :ets.update_element(@name_table, key, {4, latency})
+      [{_, _, _, avg, _}] -> :ets.update_element(@name_table, key, {4, round(avg + @alpha * (latency - avg))})
+      [] -> false
+    end
+    :ok
+  end
+
+  def down(%{group: group, down_interval: interval}, idx) do
+    :ets.update_element(@name_table, {:endpoint, group, idx}, {5, now() + interval})
+    :ok
+  end
+
+  def up(%{group: group}, idx) do
+    :ets.update_element(@name_table, {:endpoint, group, idx}, {5, 0})
+    :ok
+  end
+
+  @doc "Current `{host, port, latency_us, down?}` per endpoint."
+  def info(%{group: group}) do
+    now = now()
+    :ets.select(@name_table, [{{{:endpoint, group, :_}, :"$1", :"$2", :"$3", :"$4"}, [], [{{:"$1", :"$2", :"$3", :"$4"}}]}])
+    |> Enum.map(fn {host, port, latency, down_until} -> {host, port, latency, down_until > now} end)
+  end
+
+  defp now(), do: System.monotonic_time(:millisecond)
+end
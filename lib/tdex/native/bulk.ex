@@ -0,0 +1,130 @@
+defmodule Tdex.Native.Bulk do
+  @moduledoc false
+  # Tdex.bulk_load/5 on a native connection. Rows are bound a whole batch at a
+  # time into column buffers by `taos_stmt_bind_rows`, which also parses CSV
+  # lines and converts values. Two statements alternate so the next batch is
+  # bound while the previous one executes in a task.
+  alias Tdex.{Wrapper, Telemetry}
+
+  @pending {__MODULE__, :pending}
+
+  @types %{ts: 9, bool: 1, int8: 2, int16: 3, int32: 4, int64: 5, float: 6, double: 7,
+    varchar: 8, nchar: 10, varbinary: 16}
+
+  def load(conn, table, schema, stream, opts) do
+    columns = Enum.sort_by(schema, fn {_name, {_type, idx}} -> idx end)
+    names = Enum.map(columns, &elem(&1, 0))
+    types = Enum.map(columns, fn {_name, {type, _idx}} -> Map.fetch!(@types, type) end)
+    sql = ~c"INSERT INTO #{table} (#{Enum.join(names, ",")}) VALUES (#{Enum.map_join(names, ",", fn _ -> "?" end)})"
+    meta = %{protocol: Tdex.Native, table: table}
+
+    Telemetry.span_measure([:bulk_load], meta, fn ->
+      result = run(conn, sql, names, types, stream, opts)
+      {result, measurements(result)}
+    end)
+  end
+
+  defp run(conn, sql, names, types, stream, opts) do
+    t0 = System.monotonic_time()
+    {:ok, stmt1} = Wrapper.taos_stmt_init(conn, sql)
+    {:ok, stmt2} = Wrapper.taos_stmt_init(conn, sql)
+    try do
+      state = %{stmts: {stmt1, stmt2}, pending: nil, names: names, types: types, bound: 0,
+        stats: %{rows: 0, batches: 0, affected_rows: 0}}
+      stream
+      |> rows(names, opts)
+      |> Stream.chunk_every(Keyword.get(opts, :batch_rows, 10_000))
+      |> Enum.reduce_while(state, &pipeline/2)
+      |> await()
+      |> case do
+        {:ok, stats} ->
+          duration = System.convert_time_unit(System.monotonic_time() - t0, :native, :millisecond)
+          {:ok, Map.merge(stats, %{duration_ms: duration, rows_per_sec: div(stats.rows * 1000, max(duration, 1))})}
+        error -> error
+      end
+    after
+      # a raising stream leaves the last execute running on its stmt
+      case Process.delete(@pending) do
+        nil -> :ok
+        task -> Task.yield(task, :infinity)
+      end
+      Wrapper.taos_stmt_close(stmt1)
+      Wrapper.taos_stmt_close(stmt2)
+    end
+  end
+
+  defp pipeline(batch, %{stmts: {stmt, next}} = state) do
+    case bind(stmt, batch, state) do
+      {:ok, rows} ->
+        case await(state) do
+          {:ok, stats} ->
+            task = Task.async(fn -> {Wrapper.taos_stmt_execute(stmt), rows} end)
+            Process.put(@pending, task)
+            {:cont, %{state | stmts: {next, stmt}, pending: task, stats: stats, bound: state.bound + rows}}
+          error -> {:halt, error}
+        end
+      {:error, reason} ->
+        await(state)
+        {:halt, {:error, bind_error(reason, state)}}
+    end
+  end
+
+  defp bind(stmt, batch, state) do
+    case Enum.find_index(batch, &(&1 == :bad_row)) do
+      nil -> Wrapper.taos_stmt_bind_rows(stmt, state.types, batch)
+      row -> {:error, {:bad_row, row}}
+    end
+  end
+
+  defp await({:error, _} = error), do: error
+  defp await(%{pending: nil, stats: stats}), do: {:ok, stats}
+  defp await(%{pending: task, stats: stats}) do
+    result = Task.await(task, :infinity)
+    Process.delete(@pending)
+    case result do
+      {{:ok, affected_rows}, rows} ->
+        Telemetry.event([:bulk_load, :batch], %{rows: rows, affected_rows: affected_rows})
+        {:ok, %{stats | rows: stats.rows + rows, batches: stats.batches + 1, affected_rows: stats.affected_rows + affected_rows}}
+      {{_, code, message}, _rows} ->
+        {:error, %Tdex.Error{code: code, message: message}}
+    end
+  end
+
+  # `bound` counts the rows of every batch bound so far, executed or still pending
+  defp bind_error({:bad_row, row}, %{bound: bound}) do
+    %Tdex.Error{message: "malformed row #{bound + row + 1}"}
+  end
+  defp bind_error({:bad_value, row, col}, %{bound: bound, names: names}) do
+    %Tdex.Error{message: "invalid value for column #{Enum.at(names, col)} at row #{bound + row + 1}"}
+  end
+  defp bind_error(:less_memory, _state), do: %Tdex.Error{code: :less_memory, message: "out of memory binding rows"}
+  defp bind_error({code, message}, _state) when is_integer(code), do: %Tdex.Error{code: code, message: message}
+  defp bind_error(reason, _state), do: %Tdex.Error{message: to_string(reason)}
+
+  defp measurements({:ok, stats}), do: Map.take(stats, [:rows, :batches, :affected_rows])
+  defp measurements(_), do: %{}
+
+  # CSV chunks may end anywhere, complete lines are passed on and the tail is
+  # carried into the next chunk.
+  defp rows(stream, names, opts) do
+    stream
+    |> Stream.transform(fn -> "" end, &split_lines/2, &last_line/1, fn _ -> :ok end)
+    |> Stream.reject(&(&1 == ""))
+    |> then(fn rows -> if opts[:header], do: Stream.drop(rows, 1), else: rows end)
+    |> Stream.map(&to_row(&1, names))
+  end
+
+  defp split_lines(chunk, rest) when is_binary(chunk) do
+    [rest | lines] = :binary.split(rest <> chunk, "\n", [:global]) |> Enum.reverse()
+    {Enum.reverse(lines), rest}
+  end
+  defp split_lines(row, rest), do: {[row], rest}
+
+  defp last_line(""), do: {[], ""}
+  defp last_line(rest), do: {[rest], ""}
+
+  defp to_row(row, _names) when is_binary(row) or is_list(row), do: row
+  defp to_row(row, _names) when is_tuple(row), do: Tuple.to_list(row)
+  defp to_row(row, names) when is_map(row), do: Enum.map(names, &Map.get(row, &1))
+  defp to_row(_row, _names), do: :bad_row
+end
@@ -0,0 +1,129 @@
+defmodule Tdex.Native.Prepared do
+  @moduledoc false
+  # `bind_params: true`: parameterized statements are prepared once per
+  # connection with taos_stmt_prepare and executed with their values bound
+  # natively. Insert parameters take the column types the server reports,
+  # query parameters are typed from the values. Anything that cannot be
+  # prepared or bound returns :fallback and goes through interpolation, so do
+  # timestamps when the database precision is unknown (`precision` is nil).
+  # `stmts` is `%{sql => {entry, last_used}}` plus a `:tick` counter; the least
+  # recently used statement is closed past @max_statements, and a statement
+  # whose bind or execute failed is closed rather than reused.
+  alias Tdex.{Wrapper, Deadline, Native, Telemetry}
+
+  @max_statements 64
+  @bigint 5
+  @double 7
+  @bool 1
+  @varchar 8
+  @timestamp 9
+
+  def query(conn, stmts, sql, params, precision, deadline) do
+    case prepare(conn, stmts, sql) do
+      {:unprepared, stmts} -> {:fallback, stmts}
+      {{stmt, insert_types}, stmts} ->
+        with {:ok, types} <- types(insert_types, params),
+          {:ok, values} <- values(params, precision)
+        do
+          case Wrapper.taos_stmt_bind_row(stmt, types, values) do
+            {:ok, _} ->
+              case execute(conn, stmt, insert_types != nil, deadline) do
+                {:ok, _} = result -> {result, stmts}
+                error -> {error, drop(stmts, sql)}
+              end
+            _ ->
+              {:fallback, drop(stmts, sql)}
+          end
+        else
+          _ -> {:fallback, stmts}
+        end
+    end
+  end
+
+  defp prepare(conn, stmts, sql) do
+    tick = Map.get(stmts, :tick, 0) + 1
+    case Map.fetch(stmts, sql) do
+      {:ok, {entry, _}} -> {entry, %{stmts | sql => {entry, tick}, tick: tick}}
+      :error ->
+        entry =
+          with {:ok, stmt} <- Wrapper.taos_stmt_init(conn, :erlang.binary_to_list(sql)) do
+            case Wrapper.taos_stmt_param_types(stmt) do
+              {:ok, types} -> {stmt, types}
+              _ ->
+                Wrapper.taos_stmt_close(stmt)
+                :unprepared
+            end
+          else
+            _ -> :unprepared
+          end
+        {entry, stmts |> evict() |> Map.merge(%{sql => {entry, tick}, tick: tick})}
+    end
+  end
+
+  defp evict(stmts) when map_size(stmts) <= @max_statements, do: stmts
+  defp evict(stmts) do
+    {sql, _} = stmts |> Map.delete(:tick) |> Enum.min_by(fn {_sql, {_entry, used}} -> used end)
+    drop(stmts, sql)
+  end
+
+  # Results of the statement are read and freed before query/6 returns; the
+  # close is deferred natively while one is still live anyway.
+  defp drop(stmts, sql) do
+    with {{stmt, _}, _} <- stmts[sql], do: Wrapper.taos_stmt_close(stmt)
+    Map.delete(stmts, sql)
+  end
+
+  defp execute(conn, stmt, insert, deadline) do
+    watchdog = Deadline.watch(deadline, fn -> Wrapper.taos_kill_query(conn) end)
+    try do
+      result = Telemetry.span([:query], %{protocol: Tdex.Native, prepared: true}, fn ->
+        Wrapper.taos_stmt_execute(stmt)
+      end)
+      case result do
+        {:ok, affected_rows} when insert ->
+          {:ok, %Tdex.Result{code: 0, rows: [], affected_rows: affected_rows}}
+        {:ok, _} ->
+          {:ok, res} = Wrapper.taos_stmt_use_result(stmt)
+          Deadline.update(watchdog, fn -> Wrapper.taos_stop_query(res) end)
+          Native.read_result(res, deadline)
+        {_, code, message} ->
+          if Deadline.expired?(deadline), do: {:error, Deadline.error()}, else: {:error, %Tdex.Error{code: code, message: message}}
+      end
+    after
+      Deadline.done(watchdog)
+    end
+  end
+
+  defp types(nil, params) do
+    Enum.reduce_while(params, {:ok, []}, fn param, {:ok, acc} ->
+      case infer(param) do
+        nil -> {:halt, :unsupported}
+        type -> {:cont, {:ok, [type | acc]}}
+      end
+    end)
+    |> case do
+      {:ok, types} -> {:ok, Enum.reverse(types)}
+      error -> error
+    end
+  end
+  defp types(insert_types, params) when length(insert_types) == length(params), do: {:ok, insert_types}
+  defp types(_insert_types, _params), do: :unsupported
+
+  defp infer(v) when is_boolean(v), do: @bool
+  defp infer(v) when is_integer(v), do: @bigint
+  defp infer(v) when is_float(v), do: @double
+  defp infer(v) when is_binary(v) or is_nil(v), do: @varchar
+  defp infer(v) when is_struct(v, DateTime) or is_struct(v, Timestamp), do: @timestamp
+  defp infer(_), do: nil
+
+  defp values(params, precision) do
+    if precision == nil and Enum.any?(params, &(is_struct(&1, DateTime) or is_struct(&1, Timestamp))) do
+      :unsupported
+    else
+      {:ok, Enum.map(params, &value(&1, precision))}
+    end
+  end
+
+  defp value(v, precision) when is_struct(v, DateTime) or is_struct(v, Timestamp), do: Timestamp.to_unix(v, precision)
+  defp value(v, _precision), do: v
+end
@@ -1,22 +1,45 @@
 defmodule Tdex.Native.Rows do
-  alias Tdex.{Wrapper, Binary}
+  alias Tdex.{Wrapper, Binary, Deadline, Telemetry}
 
-  def read_row(res, [], _precision, _data) do
+  def read_row(res, fieldNames, precision, data, deadline \\ :infinity)
+  def read_row(res, [], _precision, _data, _deadline) do
     {:ok, affected_rows} = Wrapper.taos_affected_rows(res)
     {:ok, %Tdex.Result{code: 0, rows: [], affected_rows: affected_rows}}
   end
 
-  def read_row(res, fieldNames, precision, data) do
+  def read_row(res, fieldNames, precision, data, deadline) do
+    if Deadline.expired?(deadline) do
+      {:error, Deadline.error()}
+    else
+      case Telemetry.span_measure([:fetch], %{protocol: Tdex.Native}, fn -> fetch_block(res) end) do
+        {:ok, 0, _} ->
+          {:ok, affected_rows} = Wrapper.taos_affected_rows(res)
+          {:ok, %Tdex.Result{code: 0, rows: Enum.reverse(data), affected_rows: affected_rows}}
+        {:ok, rows, bin} ->
+          padding = <<0::size(128)>>
+          dataBlock = <<padding::binary, bin::binary>>
+          result = Telemetry.span_measure([:decode], %{protocol: Tdex.Native}, fn ->
+            {Binary.parse_block(dataBlock, fieldNames, precision, data), %{rows: rows}}
+          end)
+          read_row(res, fieldNames, precision, result, deadline)
+        {:error, err} -> fetch_error(err, deadline)
+      end
+    end
+  end
+
+  # a stopped query fails its pending fetch
+  defp fetch_error(err, deadline) do
+    if Deadline.expired?(deadline) do
+      {:error, Deadline.error()}
+    else
+      {:error, %Tdex.Error{message: to_string(err)}}
+    end
+  end
+
+  defp fetch_block(res) do
     case Wrapper.taos_fetch_raw_block(res) do
-      {:ok, 0, _} ->
-        {:ok, affected_rows} = Wrapper.taos_affected_rows(res)
-        {:ok, %Tdex.Result{code: 0, rows: Enum.reverse(data), affected_rows: affected_rows}}
-      {:ok, _, bin} ->
-        padding = <<0::size(128)>>
-        dataBlock = <<padding::binary, bin::binary>>
-        result = Binary.parse_block(dataBlock, fieldNames, precision, data)
-        read_row(res, fieldNames, precision, result)
-      {:error, err} -> {:error, %Tdex.Error{message: to_string(err)}}
+      {:ok, rows, bin} = result -> {result, %{bytes: byte_size(bin), rows: rows}}
+      result -> {result, %{bytes: 0, rows: 0}}
     end
   end
 end
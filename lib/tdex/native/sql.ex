@@ -1,5 +1,5 @@
 defmodule Tdex.Native do
-  alias Tdex.{Wrapper, Binary, Native.Rows}
+  alias Tdex.{Wrapper, Binary, Deadline, Native.Rows, Native.Bulk, Native.Prepared, Telemetry}
 
   def connect(opts) do
     hostname = ~c(#{opts.hostname})
@@ -10,22 +10,47 @@ defmodule Tdex.Native do
     Wrapper.taos_connect(hostname, username, password, database, port)
   end
 
-  def query(conn, statement) do
-    {:ok, res} = Wrapper.taos_query(conn, :erlang.binary_to_list(statement))
+  def query(conn, statement, deadline \\ :infinity) do
+    watchdog = Deadline.watch(deadline, fn -> Wrapper.taos_kill_query(conn) end)
+    try do
+      case Telemetry.span([:query], %{protocol: Tdex.Native}, fn ->
+        Wrapper.taos_query(conn, :erlang.binary_to_list(statement))
+      end) do
+        {:ok, res} ->
+          Deadline.update(watchdog, fn -> Wrapper.taos_stop_query(res) end)
+          read_result(res, deadline)
+        {:error, reason} ->
+          {:error, %Tdex.Error{message: "taos_query failed: #{reason}"}}
+      end
+    after
+      Deadline.done(watchdog)
+    end
+  end
+
+  @doc false
+  def read_result(res, deadline) do
     try do
       {:ok, 0} = Wrapper.taos_errno(res)
       {:ok, fields} = Wrapper.taos_fetch_fields(res)
       {:ok, precision} = Wrapper.taos_result_precision(res)
       fieldNames = Binary.parse_field(fields, [])
-      Rows.read_row(res, fieldNames, precision, [])
+      Rows.read_row(res, fieldNames, precision, [], deadline)
     catch _, _ex ->
-      {:ok, err_msg} = Wrapper.taos_errstr(res)
-      {:error, %Tdex.Error{message: err_msg}}
+      if Deadline.expired?(deadline) do
+        {:error, Deadline.error()}
+      else
+        {:ok, err_msg} = Wrapper.taos_errstr(res)
+        {:error, %Tdex.Error{message: err_msg}}
+      end
     after
       Wrapper.taos_free_result(res)
     end
   end
 
+  def prepared_query(conn, stmts, sql, params, precision, deadline) do
+    Prepared.query(conn, stmts, sql, params, precision, deadline)
+  end
+
   def statement_init(conn, sql) do
     Wrapper.taos_stmt_init(conn, sql)
   end
@@ -81,6 +106,10 @@ defmodule Tdex.Native do
     Wrapper.taos_stmt_close(stmt)
   end
 
+  def bulk_load(conn, table, schema, stream, opts) do
+    Bulk.load(conn, table, schema, stream, opts)
+  end
+
   def test() do
     [{:undefined, p, :supervisor, [DBConnection.ConnectionPool.Pool]}] = Process.whereis(DBConnection.ConnectionPool.Supervisor) |> Supervisor.which_children()
     [{{Tdex.DBConnection, _, _}, p1, :worker, [DBConnection.Connection]}|_] = Supervisor.which_children(p)
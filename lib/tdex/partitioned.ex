@@ -0,0 +1,113 @@
+defmodule Tdex.Partitioned do
+  @moduledoc """
+  `pool_mode: :partitioned` pool: `partitions` (default one per scheduler, at most `pool_size`)
+  DBConnection pools under one supervisor, `pool_size` connections spread over them.
+
+  Callers use the partition of the scheduler they run on, so short concurrent queries do not
+  all queue on one pool and mostly stay on the same core. When the home partition has every
+  connection checked out the call goes to the next partition with a free connection, and queues
+  on the home partition only when all are busy. In-flight counts are kept in `:atomics`.
+  `name:` registers the supervisor; the routing entry (under the pid and the name) and partition
+  pids are kept in the `:tdex` ETS table and removed when the supervisor stops. Until the first
+  partitioned pool starts, calls on plain pools skip the routing lookup.
+  """
+  use Supervisor
+  @name_table :tdex
+  @started {__MODULE__, :started}
+
+  def start_link(opts) do
+    size = max(Keyword.get(opts, :pool_size, 1), 1)
+    n = opts |> Keyword.get(:partitions, System.schedulers_online()) |> min(size) |> max(1)
+    {name, opts} = Keyword.pop(opts, :name)
+    sup_opts = if name, do: [name: name], else: []
+    # written once per VM, so later pools do not trigger a persistent_term GC
+    unless :persistent_term.get(@started, false), do: :persistent_term.put(@started, true)
+    Supervisor.start_link(__MODULE__, {opts, n, size, name}, sup_opts)
+  end
+
+  @impl true
+  def init({opts, n, size, name}) do
+    sup = self()
+    sizes = List.to_tuple(for i <- 0..(n - 1), do: div(size, n) + if(i < rem(size, n), do: 1, else: 0))
+    part = %{sup: sup, name: name, partitions: n, sizes: sizes, load: :atomics.new(n, [])}
+    routes = %{id: :routes, start: {GenServer, :start_link, [__MODULE__.Routes, part]}}
+    children =
+      for i <- 0..(n - 1) do
+        pool_opts = Keyword.put(opts, :pool_size, elem(sizes, i))
+        %{id: {:partition, i}, start: {__MODULE__, :start_pool, [pool_opts, sup, i]}, type: :supervisor}
+      end
+    # routes start first and stop last
+    Supervisor.init([routes | children], strategy: :one_for_one)
+  end
+
+  @doc false
+  def start_pool(opts, sup, i) do
+    case DBConnection.start_link(Tdex.DBConnection, opts) do
+      {:ok, pid} ->
+        :ets.insert(@name_table, {{:partition, sup, i}, pid})
+        {:ok, pid}
+      error -> error
+    end
+  end
+
+  @doc "Runs `fun` with the pool `conn` routes to; plain DBConnection pools are passed through."
+  def run(conn, fun) do
+    case :persistent_term.get(@started, false) and :ets.lookup(@name_table, {:partitioned, conn}) do
+      false -> fun.(conn)
+      [] -> fun.(conn)
+      [{_, part}] ->
+        i = pick(part)
+        try do
+          fun.(:ets.lookup_element(@name_table, {:partition, part.sup, i}, 2))
+        after
+          :atomics.sub(part.load, i + 1, 1)
+        end
+    end
+  end
+
+  def stop(sup) do
+    Supervisor.stop(sup)
+  end
+
+  defp pick(%{partitions: n, load: load} = part) do
+    home = rem(:erlang.system_info(:scheduler_id) - 1, n)
+    case Enum.find(0..(n - 1), &acquire(part, rem(home + &1, n))) do
+      nil ->
+        :atomics.add(load, home + 1, 1)
+        home
+      offset -> rem(home + offset, n)
+    end
+  end
+
+  defp acquire(%{sizes: sizes, load: load}, i) do
+    if :atomics.add_get(load, i + 1, 1) <= elem(sizes, i) do
+      true
+    else
+      :atomics.sub(load, i + 1, 1)
+      false
+    end
+  end
+
+  defmodule Routes do
+    @moduledoc false
+    # Publishes the routing entry of a partitioned pool under its pid and name and
+    # removes them, with the partition pids, when the supervisor shuts down.
+    use GenServer
+    @name_table :tdex
+
+    @impl true
+    def init(%{sup: sup, name: name} = part) do
+      Process.flag(:trap_exit, true)
+      :ets.insert(@name_table, {{:partitioned, sup}, part})
+      if name, do: :ets.insert(@name_table, {{:partitioned, name}, part})
+      {:ok, part}
+    end
+
+    @impl true
+    def terminate(_reason, %{sup: sup, name: name}) do
+      :ets.delete(@name_table, {:partitioned, sup})
+      if name, do: :ets.delete(@name_table, {:partitioned, name})
+      :ets.match_delete(@name_table, {{:partition, sup, :_}, :_})
+    end
+  end
+end
@@ -0,0 +1,475 @@
+defmodule Tdex.Spool do
+  @moduledoc """
+  Disk-backed spool in front of the stmt insert path, so producers keep a flat insert latency
+  through write bursts, slow compactions or a server that is briefly unreachable.
+
+      {:ok, _} = Tdex.Spool.start_link(name: :ingest, conn: pid, dir: "/var/lib/app/spool")
+      :ok = Tdex.Spool.insert(:ingest, %Tdex.Query{schema: schema, statement: sql}, rows)
+
+  While the server is healthy `insert/3` executes directly with a deadline of `slow_ms`, which
+  cancels the execute natively (see `Tdex.Deadline`). When that fails or times out the rows are
+  appended to the spool instead and later inserts go there too, until a background drainer has
+  replayed the backlog, merging consecutive records of the same statement into batches of up to
+  `batch_rows` rows, and the last batch executed within `slow_ms`. Delivery is at least once: a
+  timed out direct insert or a batch executed just before a crash may be written again, which
+  TDengine absorbs as same-timestamp updates.
+
+  A failed batch is retried every `retry_ms` while the server is unreachable or the batch ran
+  into its deadline. When the server still answers a probe the batch itself was rejected: a
+  merged batch is replayed record by record, and a record rejected on its own is moved to
+  `<dir>/dead_letter` (same record format, never replayed) so it does not block the backlog.
+
+  Records are appended to segment files `<dir>/<seq>.seg` of up to `segment_bytes` as
+  `<<size::32, crc32::32, term_to_binary({statement, schema, rows})::binary>>`. The drained
+  position is kept in `<dir>/checkpoint`; segments behind it are deleted. The drainer only reads
+  bytes whose append has returned; a record failing its checksum is logged, counted and
+  skipped, and a torn record at the very end of the last segment is truncated when the spool
+  starts.
+
+  Options:
+
+    * `:name`, `:conn`, `:dir` - required
+    * `:max_bytes` - backlog cap (default 1 GiB), beyond it `insert/3` returns `{:error, :spool_full}`
+    * `:segment_bytes` - segment size (default 64 MiB)
+    * `:fsync` - `:always` (before `insert/3` returns), `{:interval, ms}` (default 100) or `:never`
+    * `:slow_ms` - direct insert deadline and drain latency to switch back (default 500)
+    * `:batch_rows` - rows per drain batch (default 50_000)
+    * `:drain_timeout` - deadline of one drain batch (default 30_000)
+    * `:retry_ms` - pause after a failed drain batch (default 1000)
+    * `:always_spool` - never insert directly
+    * `:paused` - start without draining, see `resume/1`
+
+  Telemetry: `[:tdex, :spool, :append]` `%{rows, bytes, backlog}`, `[:tdex, :spool, :drain]`
+  `%{rows, duration, backlog}`, `[:tdex, :spool, :drain_error]` `%{backlog}`,
+  `[:tdex, :spool, :dead_letter]` `%{rows}`, `[:tdex, :spool, :corrupt]` `%{records}` and
+  `[:tdex, :spool, :full]` `%{rows}`, all with meta `%{name}`. `info/1` returns the counters.
+  """
+  use GenServer
+  require Logger
+  alias Tdex.Telemetry
+
+  @name_table :tdex
+  @checkpoint "checkpoint"
+  @dead_letter "dead_letter"
+  @header 8
+  @probe_ms 2_000
+
+  def start_link(opts) do
+    GenServer.start_link(__MODULE__, opts, name: Keyword.fetch!(opts, :name))
+  end
+
+  def child_spec(opts) do
+    %{id: {__MODULE__, Keyword.fetch!(opts, :name)}, start: {__MODULE__, :start_link, [opts]}}
+  end
+
+  @doc "Inserts `rows` with the stmt `query`, or spools them. Returns `:ok` or `{:error, reason}`."
+  def insert(spool, %Tdex.Query{schema: schema} = query, rows) when is_map(schema) do
+    case :ets.lookup(@name_table, {:spool, spool}) do
+      [{_, :direct, conn, slow_ms}] ->
+        case Tdex.execute(conn, query, rows, deadline: System.monotonic_time(:millisecond) + slow_ms) do
+          {:ok, _, _} -> :ok
+          {:error, _} -> GenServer.call(spool, {:append, query, rows, :slow})
+        end
+      _ ->
+        GenServer.call(spool, {:append, query, rows, nil})
+    end
+  end
+
+  def info(spool), do: GenServer.call(spool, :info)
+
+  @doc "Stops draining; inserts keep going to the spool."
+  def pause(spool), do: GenServer.call(spool, {:paused, true})
+
+  def resume(spool), do: GenServer.call(spool, {:paused, false})
+
+  @impl true
+  def init(opts) do
+    Process.flag(:trap_exit, true)
+    dir = Keyword.fetch!(opts, :dir)
+    File.mkdir_p!(dir)
+    segments = case list_segments(dir) do
+      [] -> [0]
+      segments -> segments
+    end
+    active = List.last(segments)
+    recover_tail(segment_path(dir, active))
+    {seq, _} = pos = read_checkpoint(dir, hd(segments))
+    {drained, segments} = Enum.split_while(segments, &(&1 < seq and &1 != active))
+    Enum.each(drained, &File.rm(segment_path(dir, &1)))
+    sizes = Map.new(segments, &{&1, file_size(segment_path(dir, &1))})
+    pos = checked_pos(dir, pos, sizes)
+    {:ok, fd} = :file.open(segment_path(dir, active), [:append, :raw, :binary])
+    state = %{
+      name: Keyword.fetch!(opts, :name),
+      conn: Keyword.fetch!(opts, :conn),
+      dir: dir,
+      fd: fd,
+      active: active,
+      segments: segments,
+      sizes: sizes,
+      pos: pos,
+      backlog: backlog(sizes, pos),
+      max_bytes: Keyword.get(opts, :max_bytes, 1_073_741_824),
+      segment_bytes: Keyword.get(opts, :segment_bytes, 67_108_864),
+      fsync: Keyword.get(opts, :fsync, {:interval, 100}),
+      slow_ms: Keyword.get(opts, :slow_ms, 500),
+      batch_rows: Keyword.get(opts, :batch_rows, 50_000),
+      drain_timeout: Keyword.get(opts, :drain_timeout, 30_000),
+      retry_ms: Keyword.get(opts, :retry_ms, 1000),
+      always_spool: Keyword.get(opts, :always_spool, false),
+      paused: Keyword.get(opts, :paused, false),
+      drain: nil,
+      retry: nil,
+      isolate: nil,
+      dirty: false,
+      appended_rows: 0,
+      drained_rows: 0,
+      rejected_rows: 0,
+      dead_rows: 0,
+      corrupt_records: 0
+    }
+    schedule_fsync(state.fsync)
+    state = if state.backlog > 0, do: set_mode(state, :spool), else: set_mode(state, :direct)
+    {:ok, maybe_drain(state)}
+  end
+
+  @impl true
+  def handle_call({:append, query, rows, reason}, _from, state) do
+    payload = :erlang.term_to_binary({query.statement, query.schema, rows})
+    bytes = byte_size(payload) + @header
+    if state.backlog + bytes > state.max_bytes do
+      Telemetry.event([:spool, :full], %{rows: length(rows)}, %{name: state.name})
+      {:reply, {:error, :spool_full}, %{state | rejected_rows: state.rejected_rows + length(rows)}}
+    else
+      state = state |> rotate(bytes) |> write(record(payload), bytes)
+      state = %{state | appended_rows: state.appended_rows + length(rows)}
+      state = if reason == :slow, do: set_mode(state, :spool), else: state
+      Telemetry.event([:spool, :append], %{rows: length(rows), bytes: bytes, backlog: state.backlog}, %{name: state.name})
+      {:reply, :ok, maybe_drain(state)}
+    end
+  end
+
+  def handle_call(:info, _from, state) do
+    [{_, mode, _, _}] = :ets.lookup(@name_table, {:spool, state.name})
+    info = Map.take(state, [:backlog, :segments, :pos, :paused, :appended_rows, :drained_rows, :rejected_rows,
+      :dead_rows, :corrupt_records])
+    {:reply, Map.put(info, :mode, mode), state}
+  end
+
+  def handle_call({:paused, paused}, _from, state) do
+    state = %{state | paused: paused}
+    state = cond do
+      paused -> set_mode(state, :spool)
+      state.backlog == 0 -> set_mode(state, :direct)
+      true -> maybe_drain(state)
+    end
+    {:reply, :ok, state}
+  end
+
+  @impl true
+  def handle_info({ref, result}, %{drain: ref} = state) do
+    Process.demonitor(ref, [:flush])
+    handle_drain(result, %{state | drain: nil})
+  end
+
+  def handle_info({:DOWN, ref, :process, _, reason}, %{drain: ref} = state) do
+    handle_drain({:transient, reason}, %{state | drain: nil})
+  end
+
+  def handle_info(:retry, state) do
+    {:noreply, maybe_drain(%{state | retry: nil})}
+  end
+
+  def handle_info(:fsync, state) do
+    if state.dirty, do: :file.datasync(state.fd)
+    schedule_fsync(state.fsync)
+    {:noreply, %{state | dirty: false}}
+  end
+
+  def handle_info({:EXIT, _, :normal}, state) do
+    {:noreply, state}
+  end
+
+  def handle_info({:EXIT, _, reason}, state) do
+    {:stop, reason, state}
+  end
+
+  @impl true
+  def terminate(_reason, state) do
+    :file.datasync(state.fd)
+    :file.close(state.fd)
+    :ets.delete(@name_table, {:spool, state.name})
+  end
+
+  defp handle_drain({:ok, pos, rows, duration, corrupt}, state) do
+    state = advance(state, pos, corrupt)
+    state = %{state | drained_rows: state.drained_rows + rows}
+    Telemetry.event([:spool, :drain], %{rows: rows, duration: duration, backlog: state.backlog}, %{name: state.name})
+    state = if state.backlog == 0 and duration <= System.convert_time_unit(state.slow_ms, :millisecond, :native),
+      do: set_mode(state, :direct), else: state
+    {:noreply, maybe_drain(state)}
+  end
+
+  # Everything appended before the drain started has been read; later appends
+  # are picked up by maybe_drain.
+  defp handle_drain({:empty, pos, corrupt}, state) do
+    state = advance(state, pos, corrupt)
+    state = if state.backlog == 0, do: set_mode(state, :direct), else: state
+    {:noreply, maybe_drain(state)}
+  end
+
+  defp handle_drain({:rejected, _error, pos, _batch, records, _corrupt}, state) when records > 1 do
+    {:noreply, maybe_drain(%{state | isolate: pos})}
+  end
+
+  defp handle_drain({:rejected, error, pos, {statement, schema, rows}, _records, corrupt}, state) do
+    Logger.error("tdex spool #{state.dir}: moving #{length(rows)} rows to #{@dead_letter}, #{inspect(error)}")
+    File.write!(Path.join(state.dir, @dead_letter), record(:erlang.term_to_binary({statement, schema, rows})), [:append, :sync])
+    Telemetry.event([:spool, :dead_letter], %{rows: length(rows)}, %{name: state.name})
+    state = advance(state, pos, corrupt)
+    {:noreply, maybe_drain(%{state | dead_rows: state.dead_rows + length(rows)})}
+  end
+
+  defp handle_drain({:transient, error}, state) do
+    Logger.warning("tdex spool #{state.dir}: drain failed, #{inspect(error)}")
+    Telemetry.event([:spool, :drain_error], %{backlog: state.backlog}, %{name: state.name})
+    {:noreply, %{state | retry: Process.send_after(self(), :retry, state.retry_ms)}}
+  end
+
+  defp set_mode(state, mode) do
+    mode = if state.always_spool or state.paused, do: :spool, else: mode
+    :ets.insert(@name_table, {{:spool, state.name}, mode, state.conn, state.slow_ms})
+    state
+  end
+
+  defp schedule_fsync({:interval, ms}), do: Process.send_after(self(), :fsync, ms)
+  defp schedule_fsync(_), do: nil
+
+  defp record(payload), do: [<<byte_size(payload)::32, :erlang.crc32(payload)::32>>, payload]
+
+  defp rotate(%{sizes: sizes, active: active} = state, bytes) do
+    size = Map.fetch!(sizes, active)
+    if size > 0 and size + bytes > state.segment_bytes do
+      :file.datasync(state.fd)
+      :file.close(state.fd)
+      active = active + 1
+      {:ok, fd} = :file.open(segment_path(state.dir, active), [:append, :raw, :binary])
+      %{state | fd: fd, active: active, segments: state.segments ++ [active], sizes: Map.put(sizes, active, 0)}
+    else
+      state
+    end
+  end
+
+  defp write(state, record, bytes) do
+    :ok = :file.write(state.fd, record)
+    if state.fsync == :always, do: :ok = :file.datasync(state.fd)
+    %{state |
+      sizes: Map.update!(state.sizes, state.active, &(&1 + bytes)),
+      backlog: state.backlog + bytes,
+      dirty: state.fsync != :always}
+  end
+
+  # `sizes` only counts appends that have returned, the drainer reads no further.
+  # While isolating a rejected batch records are replayed one at a time.
+  defp maybe_drain(%{drain: nil, retry: nil, paused: false, backlog: backlog} = state) when backlog > 0 do
+    %{conn: conn, dir: dir, segments: segments, sizes: sizes, pos: pos, drain_timeout: timeout} = state
+    batch_rows = if state.isolate, do: 0, else: state.batch_rows
+    task = Task.async(fn -> drain(conn, dir, segments, sizes, pos, batch_rows, timeout) end)
+    %{state | drain: task.ref}
+  end
+  defp maybe_drain(state), do: state
+
+  # Moves the drained position, persists it and drops the segments left behind.
+  defp advance(state, {seq, _} = pos, corrupt) do
+    write_checkpoint(state.dir, pos)
+    {drained, segments} = Enum.split_while(state.segments, &(&1 < seq))
+    Enum.each(drained, &File.rm(segment_path(state.dir, &1)))
+    sizes = Map.drop(state.sizes, drained)
+    if corrupt > 0, do: Telemetry.event([:spool, :corrupt], %{records: corrupt}, %{name: state.name})
+    isolate = if state.isolate && pos < state.isolate, do: state.isolate, else: nil
+    %{state | pos: pos, segments: segments, sizes: sizes, backlog: backlog(sizes, pos), isolate: isolate,
+      corrupt_records: state.corrupt_records + corrupt}
+  end
+
+  defp backlog(sizes, {seq, offset}) do
+    Enum.reduce(sizes, -offset, fn {s, size}, acc -> if s >= seq, do: acc + size, else: acc end)
+    |> max(0)
+  end
+
+  defp drain(conn, dir, segments, limits, pos, batch_rows, timeout) do
+    case read_batch(dir, Enum.drop_while(segments, &(&1 < elem(pos, 0))), limits, pos, batch_rows) do
+      {nil, pos, corrupt} ->
+        {:empty, pos, corrupt}
+      {{statement, schema, rows, records}, pos, corrupt} ->
+        deadline = System.monotonic_time(:millisecond) + timeout
+        t0 = System.monotonic_time()
+        result = Tdex.execute(conn, %Tdex.Query{statement: statement, schema: schema}, rows, deadline: deadline)
+        case result do
+          {:ok, _, _} -> {:ok, pos, length(rows), System.monotonic_time() - t0, corrupt}
+          {:error, error} -> failed(conn, error, {pos, {statement, schema, rows}, records, corrupt})
+        end
+    end
+  catch kind, ex ->
+    {:transient, {kind, ex}}
+  end
+
+  # A batch the server turns down while it still answers a probe is bad data, not an outage.
+  defp failed(conn, error, {pos, batch, records, corrupt}) do
+    if rejected?(conn, error),
+      do: {:rejected, error, pos, batch, records, corrupt},
+      else: {:transient, error}
+  end
+
+  defp rejected?(_conn, %DBConnection.ConnectionError{}), do: false
+  defp rejected?(_conn, %Tdex.Error{code: :deadline}), do: false
+  defp rejected?(conn, _error) do
+    match?({:ok, _, _}, Tdex.query(conn, "SELECT SERVER_STATUS()", [], timeout: @probe_ms))
+  end
+
+  # Reads records from `pos` on, at most up to `limits[seq]` bytes per segment, merging
+  # consecutive ones of the same statement and schema up to `batch_rows` rows. Returns
+  # `{{statement, schema, rows, records} | nil, next_pos, corrupt_records_skipped}`.
+  defp read_batch(dir, segments, limits, pos, batch_rows) do
+    read_batch(dir, segments, limits, pos, batch_rows, nil, 0)
+  end
+
+  defp read_batch(_dir, [], _limits, pos, _batch_rows, batch, corrupt), do: {finish(batch), pos, corrupt}
+  defp read_batch(dir, [seq | rest], limits, {_, offset}, batch_rows, batch, corrupt) do
+    limit = Map.get(limits, seq, 0)
+    {:ok, fd} = :file.open(segment_path(dir, seq), [:read, :raw, :binary])
+    result =
+      try do
+        {:ok, _} = :file.position(fd, offset)
+        read_records(fd, seq, offset, limit, batch_rows, batch, corrupt)
+      after
+        :file.close(fd)
+      end
+    case result do
+      {:eof, batch, corrupt} when rest != [] -> read_batch(dir, rest, limits, {hd(rest), 0}, batch_rows, batch, corrupt)
+      {:eof, batch, corrupt} -> {finish(batch), {seq, max(offset, limit)}, corrupt}
+      {:full, batch, pos, corrupt} -> {finish(batch), pos, corrupt}
+    end
+  end
+
+  defp read_records(fd, seq, offset, limit, batch_rows, batch, corrupt) do
+    case read_record(fd, limit - offset) do
+      {:ok, {statement, schema, rows}, bytes} ->
+        count = length(rows)
+        case batch do
+          nil ->
+            read_records(fd, seq, offset + bytes, limit, batch_rows, {statement, schema, [rows], count, 1}, corrupt)
+          {^statement, ^schema, acc, n, records} when n + count <= batch_rows ->
+            read_records(fd, seq, offset + bytes, limit, batch_rows, {statement, schema, [rows | acc], n + count, records + 1}, corrupt)
+          _ ->
+            {:full, batch, {seq, offset}, corrupt}
+        end
+      {:corrupt, bytes} ->
+        Logger.error("tdex spool #{seq}.seg: skipping #{bytes} corrupt bytes at #{offset}")
+        {:ok, _} = :file.position(fd, offset + bytes)
+        read_records(fd, seq, offset + bytes, limit, batch_rows, batch, corrupt + 1)
+      :eof ->
+        {:eof, batch, corrupt}
+    end
+  end
+
+  defp finish(nil), do: nil
+  defp finish({statement, schema, acc, _, records}), do: {statement, schema, acc |> Enum.reverse() |> Enum.concat(), records}
+
+  # One record out of the next `remaining` bytes: `{:ok, term, bytes}`, `:eof` when nothing is
+  # left, or `{:corrupt, bytes}` to skip, the whole rest when the length field cannot be trusted.
+  defp read_record(_fd, remaining) when remaining <= 0, do: :eof
+  defp read_record(fd, remaining) do
+    case :file.read(fd, @header) do
+      {:ok, <<size::32, crc::32>>} when size + @header <= remaining ->
+        case :file.read(fd, size) do
+          {:ok, payload} when byte_size(payload) == size ->
+            if :erlang.crc32(payload) == crc, do: decode(payload, size + @header), else: {:corrupt, size + @header}
+          _ ->
+            {:corrupt, remaining}
+        end
+      _ ->
+        {:corrupt, remaining}
+    end
+  end
+
+  defp decode(payload, bytes) do
+    {:ok, :erlang.binary_to_term(payload), bytes}
+  rescue
+    ArgumentError -> {:corrupt, bytes}
+  end
+
+  # Truncates the last segment after its last intact record when the damage reaches the end of
+  # the file, i.e. an append torn by a crash. Damage in the middle is left to the drainer.
+  defp recover_tail(path) do
+    case :file.open(path, [:read, :write, :raw, :binary]) do
+      {:ok, fd} ->
+        size = file_size(path)
+        valid = scan(fd, 0, size)
+        if valid < size do
+          Logger.warning("tdex spool #{path}: truncating torn tail at #{valid}")
+          {:ok, _} = :file.position(fd, valid)
+          :ok = :file.truncate(fd)
+        end
+        :file.close(fd)
+      {:error, :enoent} ->
+        :ok
+    end
+  end
+
+  defp scan(fd, offset, size) do
+    case read_record(fd, size - offset) do
+      {:ok, _, bytes} ->
+        scan(fd, offset + bytes, size)
+      {:corrupt, bytes} when offset + bytes < size ->
+        {:ok, _} = :file.position(fd, offset + bytes)
+        scan(fd, offset + bytes, size)
+      _ ->
+        offset
+    end
+  end
+
+  defp checked_pos(dir, {seq, offset} = pos, sizes) do
+    case Map.fetch(sizes, seq) do
+      {:ok, size} when offset > size ->
+        Logger.warning("tdex spool #{dir}: checkpoint past segment end, resuming at #{size}")
+        {seq, size}
+      _ -> pos
+    end
+  end
+
+  defp read_checkpoint(dir, first) do
+    case File.read(Path.join(dir, @checkpoint)) do
+      {:ok, <<seq::64, offset::64>>} when seq >= first -> {seq, offset}
+      _ -> {first, 0}
+    end
+  end
+
+  defp write_checkpoint(dir, {seq, offset}) do
+    tmp = Path.join(dir, @checkpoint <> ".tmp")
+    File.write!(tmp, <<seq::64, offset::64>>, [:sync])
+    File.rename!(tmp, Path.join(dir, @checkpoint))
+  end
+
+  defp list_segments(dir) do
+    dir
+    |> File.ls!()
+    |> Enum.flat_map(fn file ->
+      case Integer.parse(file) do
+        {seq, ".seg"} -> [seq]
+        _ -> []
+      end
+    end)
+    |> Enum.sort()
+  end
+
+  defp segment_path(dir, seq) do
+    Path.join(dir, String.pad_leading(Integer.to_string(seq), 16, "0") <> ".seg")
+  end
+
+  defp file_size(path) do
+    case File.stat(path) do
+      {:ok, %{size: size}} -> size
+      _ -> 0
+    end
+  end
+end
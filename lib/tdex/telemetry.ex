@@ -0,0 +1,49 @@
+defmodule Tdex.Telemetry do
+  @moduledoc """
+  Telemetry events emitted by Tdex. Spans emit `:start`, `:stop` and `:exception`
+  with `:monotonic_time`/`:duration` in native units.
+
+    * `[:tdex, :connect]` - opening a connection, meta `%{protocol, hostname, port}`
+    * `[:tdex, :query]` - `taos_query` or the ws `query` action, meta `%{protocol}`
+    * `[:tdex, :fetch]` - one raw block fetch, stop measurements `%{bytes, rows}`
+    * `[:tdex, :decode]` - `Tdex.Binary.parse_block` of one block, stop measurements `%{rows}`
+    * `[:tdex, :stmt, :init]`, `[:tdex, :stmt, :bind]`, `[:tdex, :stmt, :execute]` - stmt insert path
+    * `[:tdex, :bulk_load]` - `Tdex.bulk_load/5`, meta `%{protocol, table}`, stop measurements
+      `%{rows, batches, affected_rows}`; `[:tdex, :bulk_load, :batch]` event per executed batch
+    * `[:tdex, :spool, :append | :drain | :drain_error | :dead_letter | :corrupt | :full]` - `Tdex.Spool` events, see there
+    * `[:tdex, :ws, :recv]` - waiting for one ws frame, stop measurements `%{bytes}`
+    * `[:tdex, :ws, :send]` - event with measurements `%{bytes}`
+    * `[:tdex, :call]` - event per `Tdex.query`/`Tdex.execute` with DBConnection's
+      `pool_time` (checkout wait), `connection_time`, `decode_time` and `idle_time`
+
+  `stats/0` reads the native counters without going through the connection.
+  """
+
+  def span(event, meta, fun) do
+    :telemetry.span([:tdex | event], meta, fn -> {fun.(), meta} end)
+  end
+
+  def span_measure(event, meta, fun) do
+    :telemetry.span([:tdex | event], meta, fn ->
+      {result, measurements} = fun.()
+      {result, measurements, meta}
+    end)
+  end
+
+  def event(event, measurements, meta \\ %{}) do
+    :telemetry.execute([:tdex | event], measurements, meta)
+  end
+
+  def log(%DBConnection.LogEntry{} = entry) do
+    measurements =
+      [pool_time: entry.pool_time, connection_time: entry.connection_time,
+        decode_time: entry.decode_time, idle_time: entry.idle_time]
+      |> Enum.reject(fn {_k, v} -> is_nil(v) end)
+      |> Map.new()
+    event([:call], measurements, %{call: entry.call, query: entry.query, result: elem(entry.result, 0)})
+  end
+
+  def stats() do
+    Tdex.Wrapper.taos_stats()
+  end
+end
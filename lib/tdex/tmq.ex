@@ -0,0 +1,104 @@
+defmodule Tdex.TMQ do
+  @moduledoc """
+  TDengine data subscription consumer.
+
+  Polling runs on a native thread which delivers each message straight to the
+  subscriber as `{:tdex_tmq, consumer, %Tdex.TMQ.Message{}}`. Nothing is polled
+  until the subscriber asks for it, every message consumes one unit of demand,
+  and offsets are only committed when `commit/2` is called.
+
+      {:ok, tmq} = Tdex.TMQ.start_link(topics: ["meters_topic"], group_id: "g1", demand: 10)
+      receive do
+        {:tdex_tmq, ^tmq, msg} ->
+          rows = Tdex.TMQ.Message.rows(msg)
+          :ok = Tdex.TMQ.commit(tmq, msg)
+          Tdex.TMQ.ask(tmq, 1)
+      end
+  """
+  use GenServer
+  require Logger
+  require Skn.Log
+  alias Tdex.{Wrapper, TMQ.Message}
+
+  def start_link(opts) do
+    opts = Keyword.put_new(opts, :subscriber, self())
+    GenServer.start_link(__MODULE__, opts)
+  end
+
+  def ask(pid, demand \\ 1) when is_integer(demand) and demand > 0 do
+    GenServer.cast(pid, {:ask, demand})
+  end
+
+  def commit(pid, %Message{topic: topic, vgroup_id: vgroup_id, offset: offset}) do
+    commit(pid, topic, vgroup_id, offset)
+  end
+
+  def commit(pid, topic, vgroup_id, offset) do
+    GenServer.call(pid, {:commit, topic, vgroup_id, offset}, :infinity)
+  end
+
+  def stop(pid) do
+    GenServer.stop(pid, :normal, :infinity)
+  end
+
+  def init(opts) do
+    Process.flag(:trap_exit, true)
+    subscriber = Keyword.fetch!(opts, :subscriber)
+    topics = Keyword.fetch!(opts, :topics) |> Enum.map(&to_charlist/1)
+    with {:ok, tmq} <- Wrapper.tmq_consumer_new(consumer_config(opts)),
+         :ok <- Wrapper.tmq_subscribe(tmq, topics),
+         :ok <- Wrapper.tmq_consumer_start(tmq, subscriber, Keyword.get(opts, :poll_timeout, 100))
+    do
+      Process.monitor(subscriber)
+      case Keyword.get(opts, :demand, 0) do
+        0 -> :ok
+        demand -> Wrapper.tmq_consumer_ask(tmq, demand)
+      end
+      {:ok, %{tmq: tmq, subscriber: subscriber}}
+    else
+      {:error, reason} -> {:stop, %Tdex.Error{message: to_string(reason)}}
+    end
+  end
+
+  def handle_cast({:ask, demand}, state) do
+    :ok = Wrapper.tmq_consumer_ask(state.tmq, demand)
+    {:noreply, state}
+  end
+
+  def handle_call({:commit, topic, vgroup_id, offset}, _from, state) do
+    reply = case Wrapper.tmq_commit_offset(state.tmq, to_charlist(topic), vgroup_id, offset) do
+      :ok -> :ok
+      {:error, reason} -> {:error, %Tdex.Error{message: to_string(reason)}}
+    end
+    {:reply, reply, state}
+  end
+
+  def handle_info({:DOWN, _ref, :process, pid, _reason}, %{subscriber: pid} = state) do
+    {:stop, :normal, state}
+  end
+
+  def handle_info(_msg, state) do
+    {:noreply, state}
+  end
+
+  def terminate(_reason, state) do
+    Skn.Log.debug("close tmq consumer #{inspect(self())}")
+    Wrapper.tmq_consumer_close(state.tmq)
+  end
+
+  defp consumer_config(opts) do
+    [
+      {"group.id", Keyword.fetch!(opts, :group_id)},
+      {"client.id", Keyword.get(opts, :client_id, "tdex")},
+      {"td.connect.ip", Keyword.get(opts, :hostname, "localhost")},
+      {"td.connect.port", Keyword.get(opts, :port, 6030)},
+      {"td.connect.user", Keyword.get(opts, :username, "root")},
+      {"td.connect.pass", Keyword.get(opts, :password, "taosdata")},
+      {"auto.offset.reset", Keyword.get(opts, :auto_offset_reset, "latest")},
+      {"msg.with.table.name", "true"},
+      {"enable.auto.commit", "false"}
+    ]
+    |> Kernel.++(Keyword.get(opts, :config, []))
+    |> Enum.map(fn {k, v} -> {to_charlist(k), ~c(#{v})} end)
+  end
+end
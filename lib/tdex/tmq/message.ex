@@ -0,0 +1,18 @@
+defmodule Tdex.TMQ.Message do
+  alias Tdex.Binary
+
+  defstruct [:consumer, :topic, :database, :vgroup_id, :offset, :precision, blocks: []]
+
+  def rows(%__MODULE__{blocks: blocks, precision: precision}) do
+    Enum.reduce(blocks, [], fn {table, fields, block}, acc ->
+      fieldNames = Binary.parse_field(fields, [])
+      padding = <<0::size(128)>>
+      rows = Binary.parse_block(<<padding::binary, block::binary>>, fieldNames, precision, [])
+      case table do
+        nil -> rows ++ acc
+        _ -> Enum.map(rows, &Map.put(&1, :tbname, table)) ++ acc
+      end
+    end)
+    |> Enum.reverse()
+  end
+end
@@ -10,9 +10,15 @@ defmodule Tdex.Utils do
     |> Keyword.put_new(:port, default_port(Keyword.get(opts, :protocol)))
     |> Keyword.update(:protocol, Tdex.Native, &handle_protocol/1)
     |> Keyword.update!(:port, &normalize_port/1)
+    |> Keyword.update(:cache, nil, &Tdex.Cache.new/1)
+    |> handle_endpoints()
     |> Enum.reject(fn {_k, v} -> is_nil(v) end)
   end
 
+  defp handle_endpoints(opts) do
+    Keyword.update(opts, :endpoints, nil, &Tdex.Endpoints.new(&1, opts))
+  end
+
   defp normalize_port(port) when is_binary(port), do: String.to_integer(port)
   defp normalize_port(port), do: port
 
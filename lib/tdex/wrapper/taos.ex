@@ -2,8 +2,10 @@ defmodule Tdex.Wrapper do
   @compile {:autoload, false}
   @on_load {:load_nifs, 0}
 
+  # TDEX_STUB=1 loads the NIF linked against the stub libtaos (`make stub`).
   def load_nifs do
-    path = :filename.join(:code.priv_dir(:tdex), ~C"lib_taos_nif")
+    name = if System.get_env("TDEX_STUB") == "1", do: ~C"stub/lib_taos_nif", else: ~C"lib_taos_nif"
+    path = :filename.join(:code.priv_dir(:tdex), name)
     :erlang.load_nif(path, 0)
   end
 
@@ -35,7 +37,7 @@ defmodule Tdex.Wrapper do
     raise "taos_affected_rows not implemented"
   end
 
-  def taos_print_row(_row, _field, _num_fields) do
+  def taos_print_row(_res) do
     raise "taos_print_row not implemented"
   end
 
@@ -75,6 +77,14 @@ defmodule Tdex.Wrapper do
     raise "taos_kill_query not implemented"
   end
 
+  def taos_stop_query(_res) do
+    raise "taos_stop_query not implemented"
+  end
+
+  def taos_stats() do
+    raise "taos_stats not implemented"
+  end
+
   def taos_stmt_init(_taos, _param_cnt) do
     raise "nif load fail"
   end
@@ -84,6 +94,18 @@ defmodule Tdex.Wrapper do
   def taos_stmt_bind_param_batch(_stmt) do
     raise "nif load fail"
   end
+  def taos_stmt_bind_rows(_stmt, _types, _rows) do
+    raise "nif load fail"
+  end
+  def taos_stmt_bind_row(_stmt, _types, _row) do
+    raise "nif load fail"
+  end
+  def taos_stmt_param_types(_stmt) do
+    raise "nif load fail"
+  end
+  def taos_stmt_use_result(_stmt) do
+    raise "nif load fail"
+  end
   def taos_stmt_execute(_stmt) do
     raise "nif load fail"
   end
@@ -117,4 +139,22 @@ defmodule Tdex.Wrapper do
   def taos_multi_bind_set_varchar(_stmt, _index, _value) do
     raise "nif load fail"
   end
+  def tmq_consumer_new(_conf) do
+    raise "nif load fail"
+  end
+  def tmq_subscribe(_tmq, _topics) do
+    raise "nif load fail"
+  end
+  def tmq_consumer_start(_tmq, _subscriber, _timeout) do
+    raise "nif load fail"
+  end
+  def tmq_consumer_ask(_tmq, _demand) do
+    raise "nif load fail"
+  end
+  def tmq_commit_offset(_tmq, _topic, _vgroup_id, _offset) do
+    raise "nif load fail"
+  end
+  def tmq_consumer_close(_tmq) do
+    raise "nif load fail"
+  end
 end
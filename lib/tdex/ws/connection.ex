@@ -1,7 +1,15 @@
 defmodule Tdex.WS.Connection do
   import Tdex.{Ets}
+  alias Tdex.Telemetry
 
   def recv_ws(timeout) do
+    Telemetry.span_measure([:ws, :recv], %{}, fn ->
+      result = do_recv_ws(timeout)
+      {result, %{bytes: frame_size(result)}}
+    end)
+  end
+
+  defp do_recv_ws(timeout) do
     receive do
       { :gun_ws, _pid, _ref, {:text, data} } ->
         res = Jason.decode!(data)
@@ -16,6 +24,15 @@ defmodule Tdex.WS.Connection do
     end
   end
 
+  defp frame_size({:ok, data}) when is_binary(data), do: byte_size(data)
+  defp frame_size(_), do: 0
+
+  def send_ws(pid, action) do
+    data = Jason.encode!(action)
+    Telemetry.event([:ws, :send], %{bytes: byte_size(data)}, %{action: action.action})
+    Gun.ws_send(pid, {:text, data})
+  end
+
   @spec new_connect_ws(any, any) :: {:ok, pid()}|{:error, any()}
   def new_connect_ws(host, port) do
     url = "ws://#{host}:#{port}/rest/ws"
@@ -44,61 +61,82 @@ defmodule Tdex.WS.Connection do
       }
     }
 
-    Gun.ws_send(pid, {:text, Jason.encode!(action)})
+    send_ws(pid, action)
     recv_ws(args[:timeout])
   end
 
   def query(pid, statement, timeout) do
+    req_id = get_req_id()
     action = %{
       action: "query",
       args: %{
-        req_id: get_req_id(),
+        req_id: req_id,
         sql: statement
       }
     }
 
-    Gun.ws_send(pid, {:text, Jason.encode!(action)})
-    recv_ws(timeout)
+    send_ws(pid, action)
+    recv_reply(pid, req_id, nil, deadline(timeout))
   end
 
   def free_result(pid, id) do
     action = %{
-      action: "free_result  ",
+      action: "free_result",
       args: %{
         req_id: get_req_id(),
         id: id
       }
     }
 
-    Gun.ws_send(pid, {:text, Jason.encode!(action)})
+    send_ws(pid, action)
   end
 
   def fetch(pid, id, timeout) do
+    req_id = get_req_id()
     action = %{
       action: "fetch",
       args: %{
-        req_id: get_req_id(),
+        req_id: req_id,
         id: id
       }
     }
 
-    Gun.ws_send(pid, {:text, Jason.encode!(action)})
-    recv_ws(timeout)
+    send_ws(pid, action)
+    recv_reply(pid, req_id, nil, deadline(timeout))
   end
 
   def fetch_block(pid, id, timeout) do
+    req_id = get_req_id()
     action = %{
       action: "fetch_block",
       args: %{
-        req_id: get_req_id(),
+        req_id: req_id,
         id: id
       }
     }
 
-    Gun.ws_send(pid, {:text, Jason.encode!(action)})
-    recv_ws(timeout)
+    send_ws(pid, action)
+    recv_reply(pid, req_id, id, deadline(timeout))
+  end
+
+  # Replies of requests that timed out may still arrive: text frames are matched
+  # on req_id, blocks on their result id (bytes 8..15), anything else is dropped
+  # and late query results are freed.
+  defp recv_reply(pid, req_id, block_id, deadline) do
+    case recv_ws(max(deadline - System.monotonic_time(:millisecond), 0)) do
+      {:ok, <<_::64, id::64-little, _::binary>>} = reply when id == block_id -> reply
+      {:ok, %{"req_id" => ^req_id}} = reply -> reply
+      {:error, %Tdex.Error{req_id: ^req_id}} = error -> error
+      {:error, :timeout} = error -> error
+      {:ok, %{"action" => "query", "id" => id}} when is_integer(id) ->
+        free_result(pid, id)
+        recv_reply(pid, req_id, block_id, deadline)
+      _stale -> recv_reply(pid, req_id, block_id, deadline)
+    end
   end
 
+  defp deadline(timeout), do: System.monotonic_time(:millisecond) + timeout
+
   def ws_default_option(connect_timeout, recv_timeout\\ 30000) do
     default_option(connect_timeout, recv_timeout) |> Map.merge(%{protocols: [:http], is_ws: true})
   end
@@ -1,17 +1,32 @@
 defmodule Tdex.WS.Rows do
-  alias Tdex.{WS.Connection, Binary}
+  alias Tdex.{Deadline, WS.Connection, Binary, Telemetry}
 
-  def read_row(pid, dataQuery, timeout, precision, data \\ []) do
-    with {:ok, %{"completed" => false}} <- Connection.fetch(pid, dataQuery["id"], timeout),
-         {:ok, dataBlock} <- Connection.fetch_block(pid, dataQuery["id"], timeout)
+  def read_row(pid, dataQuery, timeout, deadline, precision, data \\ []) do
+    with {:ok, %{"completed" => false}} <- Connection.fetch(pid, dataQuery["id"], Deadline.timeout(deadline, timeout)),
+         {:ok, dataBlock} <- fetch_block(pid, dataQuery["id"], Deadline.timeout(deadline, timeout))
     do
-      result = Binary.parse_block(dataBlock, dataQuery["fields_names"], precision, data)
-      read_row(pid, dataQuery, timeout, precision, result)
+      <<_::binary-size(24), rows::32-little, _::binary>> = dataBlock
+      result = Telemetry.span_measure([:decode], %{protocol: Tdex.WS}, fn ->
+        {Binary.parse_block(dataBlock, dataQuery["fields_names"], precision, data), %{rows: rows}}
+      end)
+      read_row(pid, dataQuery, timeout, deadline, precision, result)
     else
       {:ok, _} ->
         Connection.free_result(pid, dataQuery["id"])
         {:ok, Enum.reverse(data)}
-      {:error, reason} -> {:error, reason}
+      {:error, reason} ->
+        Connection.free_result(pid, dataQuery["id"])
+        {:error, reason}
     end
   end
+
+  defp fetch_block(pid, id, timeout) do
+    Telemetry.span_measure([:fetch], %{protocol: Tdex.WS}, fn ->
+      case Connection.fetch_block(pid, id, timeout) do
+        {:ok, <<_::binary-size(24), rows::32-little, _::binary>> = bin} = result ->
+          {result, %{bytes: byte_size(bin), rows: rows}}
+        result -> {result, %{bytes: 0, rows: 0}}
+      end
+    end)
+  end
 end
@@ -2,7 +2,7 @@ defmodule Tdex.WS.Socket do
   require Logger
   require Skn.Log
   use GenServer
-  alias Tdex.{WS.Connection, WS.Rows}
+  alias Tdex.{Deadline, WS.Connection, WS.Rows, Telemetry}
 
   def init(opts) do
     opts = %{
@@ -29,37 +29,44 @@ defmodule Tdex.WS.Socket do
     end
   end
 
-  def query(pid, statement) do
-    GenServer.call(pid, {:query, statement}, :infinity)
+  def query(pid, statement, deadline \\ :infinity) do
+    GenServer.call(pid, {:query, statement, deadline}, :infinity)
   end
 
   def stop(pid) do
     GenServer.stop(pid, :gun_down, :infinity)
   end
 
-  def handle_call({:query, statement}, _from, state) do
-    query = Connection.query(state.pidWS, statement, state.timeout)
-    handle_query(query, state)
+  def handle_call({:query, statement, deadline}, _from, state) do
+    query = Telemetry.span([:query], %{protocol: Tdex.WS}, fn ->
+      Connection.query(state.pidWS, statement, Deadline.timeout(deadline, state.timeout))
+    end)
+    handle_query(query, deadline, state)
   end
 
-  defp handle_query({:error, _reason} = error, state) do
-    {:reply, error, state}
+  defp handle_query({:error, _reason} = error, deadline, state) do
+    {:reply, deadline_error(error, deadline), state}
   end
 
-  defp handle_query({:ok, %{"fields_lengths" => nil} = dataQuery}, state) do
+  defp handle_query({:ok, %{"fields_lengths" => nil} = dataQuery}, _deadline, state) do
     result = %Tdex.Result{code: dataQuery["code"], req_id: dataQuery["req_id"], rows: [], affected_rows: dataQuery["affected_rows"], message: dataQuery["message"]}
     {:reply, {:ok, result}, state, :hibernate}
   end
 
-  defp handle_query({:ok, dataQuery}, state) do
-    case Rows.read_row(state.pidWS, dataQuery, state.timeout, dataQuery["precision"]) do
+  defp handle_query({:ok, dataQuery}, deadline, state) do
+    case Rows.read_row(state.pidWS, dataQuery, state.timeout, deadline, dataQuery["precision"]) do
       {:ok, rows} ->
         result = %Tdex.Result{code: dataQuery["code"], req_id: dataQuery["req_id"], rows: rows, affected_rows: dataQuery["affected_rows"], message: dataQuery["message"]}
         {:reply, {:ok, result}, state, :hibernate}
-      {:error, _} = error -> {:reply, error, state, :hibernate}
+      {:error, _} = error -> {:reply, deadline_error(error, deadline), state, :hibernate}
     end
   end
 
+  defp deadline_error({:error, :timeout} = error, deadline) do
+    if Deadline.expired?(deadline), do: {:error, Deadline.error()}, else: error
+  end
+  defp deadline_error(error, _deadline), do: error
+
   def handle_info({:gun_down, _, :ws, :closed, []}, state) do
     {:stop, :gun_down, state}
   end
@@ -4,15 +4,24 @@ defmodule Tdex.WS do
     GenServer.start_link(Tdex.WS.Socket, opts)
   end
 
-  def query(conn, statement) do
-    Socket.query(conn, statement)
+  def query(conn, statement, deadline \\ :infinity) do
+    Socket.query(conn, statement, deadline)
   end
 
   def stop(conn) do
     Socket.stop(conn)
   end
 
+  def prepared_query(_conn, stmts, _sql, _params, _precision, _deadline) do
+    {:fallback, stmts}
+  end
+
+  def bulk_load(_conn, _table, _schema, _stream, _opts) do
+    {:error, %Tdex.Error{message: "bulk_load is only supported by the native protocol"}}
+  end
+
+  # queries are cancelled inside the socket process when their deadline passes
   def stop_query(_conn) do
-    raise "current, stop_query is not supported for ws"
+    :ok
   end
 end
@@ -38,6 +38,8 @@ defmodule Tdex.MixProject do
       {:elixir_make, "~> 0.7.7", runtime: false},
       {:jason, "~> 1.4"},
       {:db_connection, "~> 2.1"},
+      {:telemetry, "~> 1.0"},
+      {:benchee, "~> 1.3", only: :dev, runtime: false},
       {:observer_cli, "~> 1.7"}
     ]
   end
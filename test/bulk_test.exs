@@ -0,0 +1,61 @@
+defmodule BulkTest do
+  use ExUnit.Case
+  alias Tdex, as: T
+
+  @schema %{ts: {:ts, 0}, num: {:int32, 1}}
+
+  setup do
+    {:ok, pid} = T.start_link(database: "tdex_test", protocol: :native, pool_size: 1)
+    T.query!(pid, "DROP TABLE IF EXISTS bulk_int", [])
+    T.query!(pid, "CREATE TABLE bulk_int (ts TIMESTAMP, num INT)", [])
+    {:ok, [pid: pid]}
+  end
+
+  test "csv chunks split mid-line", context do
+    t0 = 1_700_000_000_000
+    csv = "ts,num\n" <> Enum.map_join(0..2499, "", fn i -> "#{t0 + i},#{if rem(i, 10) == 0, do: "", else: i}\n" end)
+    chunks = for <<chunk::binary-size(97) <- csv>>, do: chunk
+    tail = binary_part(csv, length(chunks) * 97, byte_size(csv) - length(chunks) * 97)
+
+    assert {:ok, stats} = T.bulk_load(context[:pid], chunks ++ [tail], "bulk_int", @schema, batch_rows: 1000, header: true)
+    assert %{rows: 2500, batches: 3, affected_rows: 2500} = stats
+    assert [%{"count(*)": 2500, "count(num)": 2250}] = T.query!(context[:pid], "SELECT COUNT(*), COUNT(num) FROM bulk_int", []).rows
+  end
+
+  test "map rows from a stream", context do
+    rows = Stream.map(1..500, fn i -> %{ts: 1_700_000_000_000 + i, num: i} end)
+    assert {:ok, %{rows: 500, batches: 5}} = T.bulk_load(context[:pid], rows, "bulk_int", @schema, batch_rows: 100)
+  end
+
+  test "bad values report the row", context do
+    rows = ["1700000000000,1", "1700000000001,x"]
+    assert {:error, %Tdex.Error{message: "invalid value for column num at row 2"}} =
+      T.bulk_load(context[:pid], rows, "bulk_int", @schema)
+  end
+
+  test "errors in a later batch report the row within the stream", context do
+    t0 = 1_700_000_000_000
+    rows = Enum.map(0..1499, fn i -> "#{t0 + i},#{if i == 1005, do: "x", else: i}" end)
+    assert {:error, %Tdex.Error{message: "invalid value for column num at row 1006"}} =
+      T.bulk_load(context[:pid], rows, "bulk_int", @schema, batch_rows: 1000)
+
+    rows = Enum.map(0..1499, fn 1005 -> :oops; i -> [t0 + i, i] end)
+    assert {:error, %Tdex.Error{message: "malformed row 1006"}} =
+      T.bulk_load(context[:pid], rows, "bulk_int", @schema, batch_rows: 1000)
+  end
+
+  test "integers out of the column range are rejected", context do
+    rows = [[1_700_000_000_000, 2_147_483_647], [1_700_000_000_001, 2_147_483_648]]
+    assert {:error, %Tdex.Error{message: "invalid value for column num at row 2"}} =
+      T.bulk_load(context[:pid], rows, "bulk_int", @schema)
+  end
+
+  test "a raising stream waits for the running batch before closing", context do
+    rows = Stream.map(0..2999, fn
+      2500 -> raise "boom"
+      i -> [1_700_000_000_000 + i, i]
+    end)
+    assert {:error, %RuntimeError{message: "boom"}} = T.bulk_load(context[:pid], rows, "bulk_int", @schema, batch_rows: 1000)
+    assert [%{"count(*)": 2000}] = T.query!(context[:pid], "SELECT COUNT(*) FROM bulk_int", []).rows
+  end
+end
@@ -0,0 +1,53 @@
+defmodule CacheTest do
+  use ExUnit.Case
+  alias Tdex.Cache
+
+  @schema %{ts: {:ts, 0}, val: {:int32, 1}}
+
+  setup do
+    name = :"cache_test_#{System.unique_integer([:positive])}"
+    on_exit(fn -> Cache.clear(name) end)
+    {:ok, [cache: Cache.new(name: name, max_tables: 2)]}
+  end
+
+  test "newest ts wins whatever the insert order", %{cache: cache} do
+    :ok = Cache.put_rows(cache, "INSERT INTO d1 VALUES (?, ?)", [%{ts: 10, val: 1}, %{ts: 30, val: 3}, %{ts: 20, val: 2}], @schema)
+    assert %{ts: 30, val: 3} == Cache.last_row(cache.name, "d1")
+
+    :ok = Cache.put_rows(cache, "INSERT INTO d1 VALUES (?, ?)", [%{ts: 25, val: 4}], @schema)
+    assert %{ts: 30, val: 3} == Cache.last_row(cache.name, "d1")
+
+    :ok = Cache.put_rows(cache, ~c"insert into test.`d1` values (?, ?)", [%{ts: 30, val: 5}], @schema)
+    assert %{ts: 30, val: 5} == Cache.last_row(cache.name, "d1")
+  end
+
+  test "tables past max_tables are not cached", %{cache: cache} do
+    for t <- ["d1", "d2", "d3"], do: :ok = Cache.put(cache, t, 1, %{ts: 1})
+    assert 2 == Cache.size(cache.name)
+    assert nil == Cache.last_row(cache.name, "d3")
+
+    :ok = Cache.put(cache, "d2", 2, %{ts: 2})
+    assert %{ts: 2} == Cache.last_row(cache.name, "d2")
+    assert 2 == length(Cache.last_rows(cache.name))
+  end
+
+  test "missing table and statements without a table name", %{cache: cache} do
+    assert nil == Cache.last_row(cache.name, "nope")
+    :ok = Cache.put_rows(cache, "INSERT INTO ? VALUES (?, ?)", [%{ts: 1, val: 1}], @schema)
+    :ok = Cache.put_rows(cache, "SELECT 1", [%{ts: 1, val: 1}], @schema)
+    assert 0 == Cache.size(cache.name)
+  end
+
+  test "warm rows are keyed by tbname with LAST_ROW names stripped", %{cache: cache} do
+    ts = ~U[2024-01-01 00:00:00.000Z]
+    rows = [
+      %{"last_row(ts)": ts, "last_row(val)": 7, tbname: "d1"},
+      %{"last_row(ts)": ts, "last_row(val)": 8}
+    ]
+    :ok = Cache.put_warm_rows(cache, rows)
+    assert %{ts: DateTime.to_unix(ts, :millisecond), val: 7} == Cache.last_row(cache.name, "d1")
+    assert 1 == Cache.size(cache.name)
+    assert :val == Cache.column_name(:"LAST_ROW(val)")
+    assert :tbname == Cache.column_name(:tbname)
+  end
+end
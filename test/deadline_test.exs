@@ -0,0 +1,32 @@
+defmodule DeadlineTest do
+  use ExUnit.Case
+  alias Tdex, as: T
+  alias Tdex.Deadline
+
+  test "watchdog cancels once and never after done" do
+    me = self()
+    w = Deadline.watch(System.monotonic_time(:millisecond) + 20, fn -> send(me, :cancelled) end)
+    assert_receive :cancelled, 500
+    :ok = Deadline.done(w)
+
+    w = Deadline.watch(System.monotonic_time(:millisecond) + 50, fn -> send(me, :cancelled) end)
+    :ok = Deadline.update(w, fn -> send(me, :stopped) end)
+    :ok = Deadline.done(w)
+    refute_receive _, 100
+  end
+
+  test "expired query is cancelled and the connection stays usable" do
+    {:ok, pid} = T.start_link(database: "tdex_test", protocol: :native, pool_size: 1)
+    assert {:error, %Tdex.Error{code: :deadline}} =
+      T.query(pid, "SELECT * FROM table_int", [], deadline: System.monotonic_time(:millisecond))
+    assert %Tdex.Result{} = T.query!(pid, "SELECT * FROM table_int", [], timeout: 5_000)
+  end
+
+  test "timeout alone cancels natively and the connection is not dropped" do
+    {:ok, pid} = T.start_link(database: "tdex_test", protocol: :native, pool_size: 1, connection_listeners: [self()])
+    assert_receive {:connected, _}, 5_000
+    assert {:error, %Tdex.Error{code: :deadline}} = T.query(pid, "SELECT * FROM table_int", [], timeout: 0)
+    assert %Tdex.Result{} = T.query!(pid, "SELECT * FROM table_int", [])
+    refute_received {:disconnected, _}
+  end
+end
@@ -0,0 +1,48 @@
+defmodule EndpointsTest do
+  use ExUnit.Case
+  alias Tdex.Endpoints
+
+  test "round robin rotates and skips endpoints marked down" do
+    eps = Endpoints.new(["a:1", {"b", 2}, "c"], port: 6030)
+    assert [{0, "a", 1}, {1, "b", 2}, {2, "c", 6030}] == Endpoints.candidates(eps)
+    assert [{1, "b", 2}, {2, "c", 6030}, {0, "a", 1}] == Endpoints.candidates(eps)
+
+    :ok = Endpoints.down(eps, 0)
+    assert [{2, "c", 6030}, {1, "b", 2}, {0, "a", 1}] == Endpoints.candidates(eps)
+    :ok = Endpoints.up(eps, 0)
+    assert [{0, "a", 1}, {1, "b", 2}, {2, "c", 6030}] == Endpoints.candidates(eps)
+  end
+
+  test "least latency prefers the fastest endpoint" do
+    eps = Endpoints.new(["a:1", "b:2"], balance: :least_latency)
+    :ok = Endpoints.report(eps, 0, 5_000)
+    :ok = Endpoints.report(eps, 1, 800)
+    assert [{1, "b", 2}, {0, "a", 1}] == Endpoints.candidates(eps)
+    assert [{1, "b", 2}, {0, "a", 1}] == Endpoints.candidates(eps)
+    for _ <- 1..20, do: Endpoints.report(eps, 1, 20_000)
+    assert [{0, "a", 1}, {1, "b", 2}] == Endpoints.candidates(eps)
+  end
+
+  test "pool connects through the next endpoint when one is unreachable" do
+    opts = [
+      database: "tdex_test",
+      protocol: :native,
+      pool_size: 2,
+      endpoints: ["127.0.0.1:1", "localhost:6030"],
+      down_interval: 60_000
+    ]
+    {:ok, pid} = Tdex.start_link(opts)
+    assert %Tdex.Result{} = Tdex.query!(pid, "SELECT * FROM table_int", [])
+    assert %Tdex.Result{} = Tdex.query!(pid, "SELECT * FROM table_int", [])
+  end
+
+  test "endpoint rows are deleted when the pool stops" do
+    count = fn -> length(:ets.match(:tdex, {{:endpoint, :_, :_}, :_, :_, :_, :_})) end
+    before = count.()
+    {:ok, pid} = Tdex.start_link(database: "tdex_test", protocol: :native, pool_size: 1, endpoints: ["localhost:6030", "127.0.0.1:6030"])
+    assert count.() == before + 2
+    GenServer.stop(pid)
+    Process.sleep(50)
+    assert count.() == before
+  end
+end
@@ -0,0 +1,86 @@
+defmodule LeakTest do
+  use ExUnit.Case
+  alias Tdex.Wrapper
+
+  @rounds 20
+  @per_round 200
+
+  setup do
+    {:ok, conn} = Wrapper.taos_connect(~c"localhost", ~c"root", ~c"taosdata", ~c"tdex_test", 6030)
+    {:ok, [conn: conn]}
+  end
+
+  test "explicit free is idempotent", context do
+    {:ok, res} = Wrapper.taos_query(context[:conn], ~c"SELECT * FROM table_int")
+    assert :ok == Wrapper.taos_free_result(res)
+    assert :ok == Wrapper.taos_free_result(res)
+    assert {:error, :invalid_resource} == Wrapper.taos_fetch_raw_block(res)
+
+    {:ok, stmt} = Wrapper.taos_stmt_init(context[:conn], ~c"INSERT INTO table_int VALUES (?, ?)")
+    assert :ok == Wrapper.taos_stmt_close(stmt)
+    assert :ok == Wrapper.taos_stmt_close(stmt)
+    assert {:error, :invalid_resource} == Wrapper.taos_stmt_execute(stmt)
+  end
+
+  test "close waits for live results and statements" do
+    {:ok, conn} = Wrapper.taos_connect(~c"localhost", ~c"root", ~c"taosdata", ~c"tdex_test", 6030)
+    {:ok, res} = Wrapper.taos_query(conn, ~c"SELECT * FROM table_int")
+    {:ok, stmt} = Wrapper.taos_stmt_init(conn, ~c"INSERT INTO table_int VALUES (?, ?)")
+    before = Wrapper.taos_stats()
+
+    assert :ok == Wrapper.taos_close(conn)
+    assert {:error, :invalid_resource} == Wrapper.taos_query(conn, ~c"SELECT 1")
+    assert Wrapper.taos_stats().live_conn == before.live_conn
+    assert {:ok, _, _} = Wrapper.taos_fetch_raw_block(res)
+    assert :ok == Wrapper.taos_free_result(res)
+    assert Wrapper.taos_stats().live_conn == before.live_conn
+    assert :ok == Wrapper.taos_stmt_close(stmt)
+    assert Wrapper.taos_stats().live_conn == before.live_conn - 1
+  end
+
+  test "handles of crashed processes are reclaimed and RSS stays flat", context do
+    conn = context[:conn]
+    crash_round(conn)
+    Process.sleep(200)
+    before = Wrapper.taos_stats()
+    rss_before = rss_kb()
+
+    for _ <- 1..@rounds, do: crash_round(conn)
+    # resource destructors of exited processes may run asynchronously
+    Process.sleep(200)
+
+    stats = Wrapper.taos_stats()
+    assert stats.live_res == before.live_res
+    assert stats.live_stmt == before.live_stmt
+    assert stats.live_binds == before.live_binds
+    assert stats.gc_res - before.gc_res == @rounds * @per_round
+    assert stats.gc_stmt - before.gc_stmt == @rounds * @per_round
+    assert rss_kb() - rss_before < 32 * 1024
+  end
+
+  defp crash_round(conn) do
+    1..@per_round
+    |> Enum.map(fn _ ->
+      spawn_monitor(fn ->
+        {:ok, _res} = Wrapper.taos_query(conn, ~c"SELECT * FROM table_int")
+        {:ok, stmt} = Wrapper.taos_stmt_init(conn, ~c"INSERT INTO table_int VALUES (?, ?)")
+        :ok = Wrapper.taos_multi_bind_set_timestamp(stmt, 0, System.system_time(:millisecond))
+        exit(:crash)
+      end)
+    end)
+    |> Enum.each(fn {pid, ref} ->
+      receive do
+        {:DOWN, ^ref, :process, ^pid, :crash} -> :ok
+      end
+    end)
+  end
+
+  defp rss_kb() do
+    File.read!("/proc/#{:os.getpid()}/status")
+    |> String.split("\n")
+    |> Enum.find_value(fn
+      "VmRSS:" <> rest -> rest |> String.trim() |> String.split() |> hd() |> String.to_integer()
+      _ -> nil
+    end)
+  end
+end
@@ -0,0 +1,42 @@
+defmodule PartitionedTest do
+  use ExUnit.Case
+  alias Tdex, as: T
+
+  test "partitioned pool serves concurrent callers and overflows to other partitions" do
+    opts = [database: "tdex_test", protocol: :native, pool_mode: :partitioned, partitions: 2, pool_size: 2]
+    {:ok, sup} = T.start_link(opts)
+    assert 2 == Enum.count(Supervisor.which_children(sup), &match?({{:partition, _}, _, _, _}, &1))
+
+    results =
+      1..64
+      |> Task.async_stream(fn _ -> T.query!(sup, "SELECT * FROM table_int", []) end, max_concurrency: 16)
+      |> Enum.map(fn {:ok, result} -> result end)
+    assert length(results) == 64
+    assert Enum.all?(results, &match?(%Tdex.Result{}, &1))
+
+    # one connection per partition: a call made while one is held goes to the other partition
+    pools = for {{:partition, _}, pid, _, _} <- Supervisor.which_children(sup), do: pid
+    {outer, inner} = Tdex.Partitioned.run(sup, fn outer -> {outer, Tdex.Partitioned.run(sup, & &1)} end)
+    assert Enum.sort([outer, inner]) == Enum.sort(pools)
+
+    :ok = Tdex.Partitioned.stop(sup)
+    assert [] == :ets.lookup(:tdex, {:partitioned, sup})
+    assert [] == :ets.match(:tdex, {{:partition, sup, :_}, :_})
+  end
+
+  test "named pools route through the name and spread pool_size exactly" do
+    opts = [database: "tdex_test", protocol: :native, pool_mode: :partitioned, partitions: 4, pool_size: 3,
+      name: :partitioned_test]
+    {:ok, sup} = T.start_link(opts)
+    assert sup == Process.whereis(:partitioned_test)
+    assert [{_, %{partitions: 3, sizes: {1, 1, 1}}}] = :ets.lookup(:tdex, {:partitioned, sup})
+    assert [{_, %{sup: ^sup}}] = :ets.lookup(:tdex, {:partitioned, :partitioned_test})
+    assert %Tdex.Result{} = T.query!(:partitioned_test, "SELECT * FROM table_int", [])
+    :ok = Tdex.Partitioned.stop(:partitioned_test)
+    assert [] == :ets.lookup(:tdex, {:partitioned, :partitioned_test})
+
+    {:ok, sup} = T.start_link(Keyword.merge(opts, pool_size: 5, partitions: 2))
+    assert [{_, %{partitions: 2, sizes: {3, 2}}}] = :ets.lookup(:tdex, {:partitioned, sup})
+    :ok = Tdex.Partitioned.stop(sup)
+  end
+end
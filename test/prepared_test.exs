@@ -0,0 +1,52 @@
+defmodule PreparedTest do
+  use ExUnit.Case
+  alias Tdex, as: T
+
+  setup do
+    {:ok, pid} = T.start_link(database: "tdex_test", protocol: :native, pool_size: 1, bind_params: true, precision: :millisecond)
+    T.query!(pid, "DROP TABLE IF EXISTS prepared_t", [])
+    T.query!(pid, "CREATE TABLE prepared_t (ts TIMESTAMP, num INT, v DOUBLE, s VARCHAR(32))", [])
+    {:ok, [pid: pid]}
+  end
+
+  test "insert and select through prepared statements", context do
+    pid = context[:pid]
+    ts = ~U[2024-01-01 00:00:00.000Z]
+    for i <- 1..10 do
+      assert %Tdex.Result{affected_rows: 1} =
+        T.query!(pid, "INSERT INTO prepared_t VALUES (?, ?, ?, ?)", [DateTime.add(ts, i, :second), i, i * 0.5, "s#{i}"])
+    end
+    assert [%{num: 3, s: "s3"}] = T.query!(pid, "SELECT num, s FROM prepared_t WHERE num = ? AND s = ?", [3, "s3"]).rows
+    assert 5 == length(T.query!(pid, "SELECT * FROM prepared_t WHERE ts > ?", [DateTime.add(ts, 5, :second)]).rows)
+  end
+
+  test "values that cannot be bound fall back to interpolation", context do
+    assert [] == T.query!(context[:pid], "SELECT * FROM prepared_t WHERE ts > ?", [~D[2024-01-01]]).rows
+  end
+
+  test "timestamps are bound in the precision read from the database" do
+    {:ok, pid} = T.start_link(database: "tdex_test", protocol: :native, pool_size: 1, bind_params: true)
+    ts = ~U[2024-01-01 00:00:00.000Z]
+    assert %Tdex.Result{affected_rows: 1} = T.query!(pid, "INSERT INTO prepared_t VALUES (?, ?, ?, ?)", [ts, 1, 0.5, "a"])
+    assert [%{num: 1}] = T.query!(pid, "SELECT num FROM prepared_t WHERE ts = ?", [ts]).rows
+  end
+
+  test "a precision: that disagrees with the database is not used to bind" do
+    {:ok, pid} = T.start_link(database: "tdex_test", protocol: :native, pool_size: 1, bind_params: true, precision: :nanosecond)
+    ts = ~U[2024-01-02 00:00:00.000Z]
+    assert %Tdex.Result{affected_rows: 1} = T.query!(pid, "INSERT INTO prepared_t VALUES (?, ?, ?, ?)", [ts, 2, 0.5, "b"])
+    assert [%{num: 2}] = T.query!(pid, "SELECT num FROM prepared_t WHERE ts = '2024-01-02 00:00:00.000'", []).rows
+  end
+
+  test "the statement cache closes the least recently used past 64", context do
+    pid = context[:pid]
+    before = Tdex.Wrapper.taos_stats().live_stmt
+    for i <- 1..70 do
+      T.query!(pid, "SELECT * FROM prepared_t WHERE num = ? LIMIT 1", [i])
+      T.query!(pid, "SELECT * FROM prepared_t WHERE num = ? LIMIT #{i + 1}", [i])
+    end
+    assert Tdex.Wrapper.taos_stats().live_stmt - before == 64
+    assert [] == T.query!(pid, "SELECT * FROM prepared_t WHERE num = ? LIMIT 1", [0]).rows
+    assert Tdex.Wrapper.taos_stats().live_stmt - before == 64
+  end
+end
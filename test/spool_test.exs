@@ -0,0 +1,107 @@
+defmodule SpoolTest do
+  use ExUnit.Case
+  alias Tdex, as: T
+  alias Tdex.Spool
+
+  @schema %{ts: {:ts, 0}, num: {:int32, 1}}
+  @query %Tdex.Query{schema: @schema, statement: ~c"INSERT INTO spool_int VALUES (?, ?)"}
+
+  setup do
+    {:ok, pid} = T.start_link(database: "tdex_test", protocol: :native, pool_size: 2)
+    T.query!(pid, "DROP TABLE IF EXISTS spool_int", [])
+    T.query!(pid, "CREATE TABLE spool_int (ts TIMESTAMP, num INT)", [])
+    dir = Path.join(System.tmp_dir!(), "tdex_spool_#{System.unique_integer([:positive])}")
+    on_exit(fn -> File.rm_rf!(dir) end)
+    {:ok, [pid: pid, dir: dir]}
+  end
+
+  test "spooled rows survive a restart and drain in merged batches", context do
+    opts = [name: :spool_test, conn: context[:pid], dir: context[:dir], segment_bytes: 4096, fsync: :always]
+    {:ok, spool} = Spool.start_link([paused: true] ++ opts)
+    for b <- 0..9, do: :ok = Spool.insert(:spool_test, @query, rows(b * 100, 100))
+    assert %{mode: :spool, appended_rows: 1000, drained_rows: 0} = Spool.info(:spool_test)
+    assert length(Spool.info(:spool_test).segments) > 1
+    GenServer.stop(spool)
+
+    {:ok, _} = Spool.start_link([batch_rows: 400] ++ opts)
+    wait_until(fn -> Spool.info(:spool_test).backlog == 0 end)
+    assert %{mode: :direct, drained_rows: 1000} = Spool.info(:spool_test)
+    assert [%{"count(*)": 1000}] = T.query!(context[:pid], "SELECT COUNT(*) FROM spool_int", []).rows
+
+    :ok = Spool.insert(:spool_test, @query, rows(1000, 10))
+    assert %{appended_rows: 0} = Spool.info(:spool_test)
+  end
+
+  test "a torn record at the tail is truncated on start", context do
+    opts = [name: :spool_test, conn: context[:pid], dir: context[:dir]]
+    {:ok, spool} = Spool.start_link([paused: true] ++ opts)
+    :ok = Spool.insert(:spool_test, @query, rows(0, 50))
+    GenServer.stop(spool)
+    [segment] = Path.wildcard(Path.join(context[:dir], "*.seg"))
+    File.write!(segment, <<1000::32, 0::32, "partial">>, [:append])
+
+    {:ok, _} = Spool.start_link(opts)
+    wait_until(fn -> Spool.info(:spool_test).backlog == 0 end)
+    assert [%{"count(*)": 50}] = T.query!(context[:pid], "SELECT COUNT(*) FROM spool_int", []).rows
+  end
+
+  test "a corrupt record mid-segment is skipped and counted", context do
+    opts = [name: :spool_test, conn: context[:pid], dir: context[:dir]]
+    {:ok, spool} = Spool.start_link([paused: true] ++ opts)
+    :ok = Spool.insert(:spool_test, @query, rows(0, 50))
+    :ok = Spool.insert(:spool_test, @query, rows(50, 30))
+    GenServer.stop(spool)
+    [segment] = Path.wildcard(Path.join(context[:dir], "*.seg"))
+    <<head::binary-size(20), byte, rest::binary>> = File.read!(segment)
+    File.write!(segment, <<head::binary, Bitwise.bxor(byte, 0xFF), rest::binary>>)
+
+    {:ok, _} = Spool.start_link(opts)
+    wait_until(fn -> Spool.info(:spool_test).backlog == 0 end)
+    assert %{corrupt_records: 1, drained_rows: 30} = Spool.info(:spool_test)
+    assert [%{"count(*)": 30}] = T.query!(context[:pid], "SELECT COUNT(*) FROM spool_int", []).rows
+  end
+
+  test "a record the server rejects goes to the dead letter file", context do
+    {:ok, _} = Spool.start_link(name: :spool_test, conn: context[:pid], dir: context[:dir], paused: true, retry_ms: 50)
+    poison = %{@query | statement: ~c"INSERT INTO spool_missing VALUES (?, ?)"}
+    :ok = Spool.insert(:spool_test, @query, rows(0, 40))
+    :ok = Spool.insert(:spool_test, poison, rows(40, 10))
+    :ok = Spool.insert(:spool_test, @query, rows(50, 40))
+    :ok = Spool.resume(:spool_test)
+    wait_until(fn -> Spool.info(:spool_test).backlog == 0 end)
+    assert %{dead_rows: 10, drained_rows: 80} = Spool.info(:spool_test)
+    assert File.exists?(Path.join(context[:dir], "dead_letter"))
+    assert [%{"count(*)": 80}] = T.query!(context[:pid], "SELECT COUNT(*) FROM spool_int", []).rows
+  end
+
+  @tag :stub
+  test "a stalled server sends inserts to the spool within slow_ms", context do
+    System.put_env("TDEX_STUB_STALL_MS", "5000")
+    on_exit(fn -> System.delete_env("TDEX_STUB_STALL_MS") end)
+    {:ok, _} = Spool.start_link(name: :spool_test, conn: context[:pid], dir: context[:dir], slow_ms: 200, drain_timeout: 300)
+    {usec, :ok} = :timer.tc(fn -> Spool.insert(:spool_test, @query, rows(0, 10)) end)
+    assert usec < 1_000_000
+    assert %{mode: :spool, appended_rows: 10} = Spool.info(:spool_test)
+  end
+
+  test "inserts beyond max_bytes are rejected", context do
+    {:ok, _} = Spool.start_link(name: :spool_test, conn: context[:pid], dir: context[:dir], paused: true, max_bytes: 2048)
+    assert :ok = Spool.insert(:spool_test, @query, rows(0, 20))
+    assert {:error, :spool_full} = Spool.insert(:spool_test, @query, rows(20, 200))
+    assert %{appended_rows: 20, rejected_rows: 200} = Spool.info(:spool_test)
+  end
+
+  defp rows(from, n) do
+    for i <- from..(from + n - 1), do: %{ts: 1_700_000_000_000 + i, num: i}
+  end
+
+  defp wait_until(fun, tries \\ 100) do
+    cond do
+      fun.() -> :ok
+      tries == 0 -> flunk("timed out")
+      true ->
+        Process.sleep(50)
+        wait_until(fun, tries - 1)
+    end
+  end
+end
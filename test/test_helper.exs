@@ -1,4 +1,6 @@
-ExUnit.start()
+# TDEX_STUB=1 (`make test-stub`) runs only the tests tagged :stub, against the stub libtaos.
+stub? = System.get_env("TDEX_STUB") == "1"
+if stub?, do: ExUnit.start(exclude: [:test], include: [:stub]), else: ExUnit.start(exclude: [:stub])
 defmodule TSQL do
 
   def cmd(args, database \\ "") do
@@ -33,7 +35,7 @@ defmodule TSQL do
 
 end
 
-TSQL.cmd(["-s", "CREATE DATABASE IF NOT EXISTS tdex_test"])
+unless stub?, do: TSQL.cmd(["-s", "CREATE DATABASE IF NOT EXISTS tdex_test"])
 
 sql_test = """
 DROP TABLE IF EXISTS table_int;
@@ -79,7 +81,7 @@ DROP TYPE IF EXISTS table_varchar;
 CREATE TABLE table_varchar (ts TIMESTAMP, str VARCHAR(265));
 """
 
-TSQL.cmd(["-s", sql_test], "tdex_test")
+unless stub?, do: TSQL.cmd(["-s", sql_test], "tdex_test")
 
 sql_insert_data = """
 INSERT INTO table_int VALUES("2023-10-18", -1);
@@ -105,7 +107,7 @@ INSERT INTO table_nchar VALUES("2023-10-18", "hoang");
 INSERT INTO table_varchar VALUES("2023-10-18", "hoang");
 """
 
-TSQL.cmd(["-s", sql_insert_data], "tdex_test")
+unless stub?, do: TSQL.cmd(["-s", sql_insert_data], "tdex_test")
 
 defmodule Tdex.TestHelper do
   defmacro query(stat, params, opts \\ []) do
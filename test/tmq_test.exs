@@ -0,0 +1,27 @@
+defmodule TMQTest do
+  use ExUnit.Case
+  import Tdex.TestHelper
+  alias Tdex, as: T
+
+  setup do
+    opts = [database: "tdex_test", backoff_type: :stop, max_restarts: 0, protocol: :native, pool_size: 1]
+    {:ok, pid} = T.start_link(opts)
+    TSQL.cmd(["-s", "CREATE TABLE IF NOT EXISTS tmq_int (ts TIMESTAMP, num INT)"], "tdex_test")
+    TSQL.cmd(["-s", "CREATE TOPIC IF NOT EXISTS tdex_tmq_topic AS SELECT ts, num FROM tdex_test.tmq_int"])
+    {:ok, [pid: pid]}
+  end
+
+  test "consume with demand and commit", context do
+    assert :ok == query("INSERT INTO tmq_int VALUES (NOW, ?)", [42])
+    group = "tdex_#{System.unique_integer([:positive])}"
+    {:ok, tmq} = Tdex.TMQ.start_link(topics: ["tdex_tmq_topic"], group_id: group, auto_offset_reset: "earliest")
+    refute_receive {:tdex_tmq, ^tmq, _}, 500
+
+    Tdex.TMQ.ask(tmq, 1)
+    assert_receive {:tdex_tmq, ^tmq, %Tdex.TMQ.Message{topic: "tdex_tmq_topic"} = msg}, 10_000
+    assert Enum.any?(Tdex.TMQ.Message.rows(msg), &match?(%{num: 42, tbname: "tmq_int"}, &1))
+    assert :ok == Tdex.TMQ.commit(tmq, msg)
+    refute_receive {:tdex_tmq, ^tmq, _}, 500
+    Tdex.TMQ.stop(tmq)
+  end
+end